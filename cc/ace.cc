@@ -6,6 +6,7 @@
 namespace jsi = json_importer;
 
 #include "point-style.hh"
+#include "trace.hh"
 
 // ----------------------------------------------------------------------
 // ~/ac/acmacs/docs/ace-format.json
@@ -189,7 +190,7 @@ static jsi::data<ChartPlotSpec> plot_spec_data = {
     // {"e", jsi::field(&ChartPlotSpec::error_lines_negative)},
     // {"g", jsi::field(&ChartPlotSpec::grid)},
     {"p", jsi::field(&ChartPlotSpec::style_for_point)},
-    {"P", jsi::field(&ChartPlotSpec::styles, plot_spec_style_data)},
+    {"P", jsi::field(&ChartPlotSpec::styles_for_json, plot_spec_style_data)},
     // {"l", jsi::field(&ChartPlotSpec::style_for_procrustes_line)},
     // {"L", jsi::field(&ChartPlotSpec::procrustes_line_styles, procrustes_line_styles_data)},
     {"s", jsi::field(&ChartPlotSpec::shown_on_all)},
@@ -332,6 +333,7 @@ static jsi::data<Ace> ace_data = {
 Chart* import_chart(std::string buffer, report_time timer)
 {
     Timeit ti("DEBUG: reading chart from " + buffer + ": ", timer);
+    acmacs_chart_internal::TraceTimer trace_timer{"import_chart"};
     if (buffer == "-")
         buffer = acmacs::file::read_stdin();
     else if (acmacs::file::xz_compressed(buffer.data()))
@@ -350,6 +352,9 @@ Chart* import_chart(std::string buffer, report_time timer)
         try {
             Ace ace(*chart);
             jsi::import(buffer, ace, ace_data);
+            chart->intern_annotations();
+            if (acmacs_chart_internal::trace_enabled())
+                acmacs_chart_internal::count(acmacs_chart_internal::Counter::TitersParsed, chart->titers().number_of_entries());
         }
         catch (AceChartReadError&) {
             throw;
@@ -382,7 +387,7 @@ template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writ
                   << jsw::end_object;
 }
 
-template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const Serum& aSerum)
+template <typename RW> inline jsw::writer<RW>& write_serum(jsw::writer<RW>& writer, const Serum& aSerum, const std::vector<size_t>& aHomologous)
 {
     return writer << jsw::start_object
                   << jsw::key("N") << aSerum.name()
@@ -392,11 +397,16 @@ template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writ
                   << jsw::if_not_empty("R", aSerum.reassortant())
                   << jsw::if_not_empty("S", aSerum.semantic())
                   << jsw::if_not_empty("a", aSerum.annotations())
-                  << jsw::if_not_empty("h", aSerum.homologous())
+                  << jsw::if_not_empty("h", aHomologous)
                   << jsw::if_not_empty("s", aSerum.serum_species())
                   << jsw::end_object;
 }
 
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const Serum& aSerum)
+{
+    return write_serum(writer, aSerum, aSerum.homologous());
+}
+
 template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const ChartInfo& aChartInfo)
 {
     return writer << jsw::start_object
@@ -509,11 +519,144 @@ template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writ
                   << jsw::end_object;
 }
 
+// ----------------------------------------------------------------------
+// ChartView is written directly from the parent chart, indices remapped on the fly
+
+template <typename RW, typename AgSr> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const acmacs_chart_internal::ChartViewEntries<AgSr>& aEntries)
+{
+    writer << jsw::start_array;
+    for (const auto& entry: aEntries)
+        writer << entry;
+    return writer << jsw::end_array;
+}
+
+  // homologous antigen indices of the parent sera are remapped to the view
+template <typename RW> inline void write_sera(jsw::writer<RW>& writer, const ChartView& aView)
+{
+    writer << jsw::start_array;
+    for (size_t sr_no = 0; sr_no < aView.number_of_sera(); ++sr_no)
+        write_serum(writer, aView.sera()[sr_no], aView.homologous(sr_no));
+    writer << jsw::end_array;
+}
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const ProjectionView& aProjection)
+{
+    writer << jsw::start_object
+           << jsw::if_not_empty("C", aProjection.column_bases_for_json())
+           << jsw::if_not_empty("D", aProjection.disconnected())
+           << jsw::if_not_empty("U", aProjection.unmovable())
+           << jsw::if_not_empty("c", aProjection.comment())
+           << jsw::if_not_equal("d", aProjection.dodgy_titer_is_regular(), false)
+           << jsw::key("e") << aProjection.stress_diff_to_stop()
+           << jsw::if_not_empty("f", aProjection.titer_multipliers())
+           << jsw::if_not_empty("g", aProjection.gradient_multipliers())
+           << jsw::key("l") << jsw::start_array;
+    const auto& layout = aProjection.layout();
+    for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no)
+        writer << layout[point_no];
+    return writer << jsw::end_array
+                  << jsw::key("m") << aProjection.minimum_column_basis_for_json()
+                  << jsw::key("s") << aProjection.stress()
+                  << jsw::key("t") << aProjection.transformation()
+                  << jsw::if_not_empty("u", aProjection.unmovable_in_last_dimension())
+                  << jsw::end_object;
+}
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const std::deque<ProjectionView>& aProjections)
+{
+    writer << jsw::start_array;
+    for (const auto& projection: aProjections)
+        writer << projection;
+    return writer << jsw::end_array;
+}
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const ChartPlotSpecView& aChartPlotSpec)
+{
+    return writer << jsw::start_object
+                  << jsw::if_not_empty("d", aChartPlotSpec.drawing_order())
+                  << jsw::if_not_empty("p", aChartPlotSpec.style_for_point())
+                  << jsw::if_not_empty("P", aChartPlotSpec.styles())
+                  << jsw::if_not_empty("s", aChartPlotSpec.shown_on_all())
+                  << jsw::end_object;
+}
+
+template <typename RW> inline void write_titer_dict(jsw::writer<RW>& writer, const ChartTiters::Dict& aDict, const ChartView& aView)
+{
+    writer << jsw::start_array;
+    for (auto ag_no: aView.antigen_indices()) {
+        writer << jsw::start_object;
+        if (ag_no < aDict.size()) { // layers of merged charts have no rows after the last antigen titrated in that layer
+            for (const auto& [serum, titer]: aDict[ag_no]) {
+                if (const auto sr_no = aView.view_serum(std::stoul(serum)); sr_no != ChartView::NotInView)
+                    writer << jsw::key(std::to_string(sr_no)) << titer;
+            }
+        }
+        writer << jsw::end_object;
+    }
+    writer << jsw::end_array;
+}
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const acmacs_chart_internal::ChartViewTiters& aTiters)
+{
+    const auto& view = aTiters.view();
+    const auto& parent = aTiters.parent();
+    writer << jsw::start_object;
+    if (!parent.layers().empty()) {
+        writer << jsw::key("L") << jsw::start_array;
+        for (const auto& layer: parent.layers())
+            write_titer_dict(writer, layer, view);
+        writer << jsw::end_array;
+    }
+    if (!parent.list().empty()) {
+        writer << jsw::key("l") << jsw::start_array;
+        for (auto ag_no: view.antigen_indices()) {
+            writer << jsw::start_array;
+            for (auto sr_no: view.serum_indices())
+                writer << parent.list()[ag_no][sr_no];
+            writer << jsw::end_array;
+        }
+        writer << jsw::end_array;
+    }
+    if (!parent.dict().empty()) {
+        writer << jsw::key("d");
+        write_titer_dict(writer, parent.dict(), view);
+    }
+    return writer << jsw::end_object;
+}
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, const ChartView& aChart)
+{
+    writer << jsw::start_object
+           << jsw::key("  version") << ACE_DUMP_VERSION
+           << jsw::key("c") << jsw::start_object
+           << jsw::if_not_empty("C", aChart.column_bases_for_json())
+           << jsw::if_not_empty("P", aChart.projections())
+           << jsw::key("a") << aChart.antigens()
+           << jsw::key("i") << aChart.chart_info_for_json()
+           << jsw::if_not_empty("p", aChart.plot_spec())
+           << jsw::key("s");
+    write_sera(writer, aChart);
+    return writer << jsw::key("t") << aChart.titers()
+                  << jsw::end_object
+                  << jsw::end_object;
+}
+
 // ----------------------------------------------------------------------
 
 void export_chart(std::string aFilename, const Chart& aChart, report_time timer)
 {
     Timeit ti("writing chart to " + aFilename + ": ", timer);
+    acmacs_chart_internal::TraceTimer trace_timer{"export_chart"};
+    jsw::export_to_json(aChart, aFilename, 1, acmacs::file::ForceCompression::Yes);
+
+} // export_chart
+
+// ----------------------------------------------------------------------
+
+void export_chart(std::string aFilename, const ChartView& aChart, report_time timer)
+{
+    Timeit ti("writing chart view to " + aFilename + ": ", timer);
+    acmacs_chart_internal::TraceTimer trace_timer{"export_chart"};
     jsw::export_to_json(aChart, aFilename, 1, acmacs::file::ForceCompression::Yes);
 
 } // export_chart
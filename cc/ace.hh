@@ -17,6 +17,7 @@ template <typename RW> jsw::writer<RW>& operator <<(jsw::writer<RW>&, const std:
 #include "acmacs-base/json-writer.hh"
 
 #include "acmacs-chart-1/chart.hh"
+#include "acmacs-chart-1/chart-view.hh"
 #include "acmacs-base/timeit.hh"
 
 // ----------------------------------------------------------------------
@@ -25,6 +26,7 @@ class AceChartReadError : public std::runtime_error { public: using std::runtime
 
 Chart* import_chart(std::string data, report_time timer = report_time::No);
 void export_chart(std::string aFilename, const Chart& aChart, report_time timer = report_time::No);
+void export_chart(std::string aFilename, const ChartView& aChart, report_time timer = report_time::No);
 
 // ----------------------------------------------------------------------
 
@@ -77,6 +77,13 @@ template <typename Data> class AntigenSerumMatchScore
             preprocess(name, aNameScoreThreshold);
         }
 
+      // aNameScore: string_match::match(aAntigen.name(), name) computed by the caller (e.g. once for all antigens with the same name)
+    inline AntigenSerumMatchScore(std::string name, const Data& aAntigen, string_match::score_t aNameScoreThreshold, string_match::score_t aNameScore)
+        : mAntigen(&aAntigen), mName(aNameScore), mFull(0)
+        {
+            preprocess_full(name, aNameScoreThreshold);
+        }
+
     inline bool operator < (const AntigenSerumMatchScore& aNother) const
         {
               // if mFull == keyword_in_lookup, move it to the end of the sorting list regardless of mName
@@ -106,14 +113,18 @@ template <typename Data> class AntigenSerumMatchScore
 
     inline void preprocess(std::string name, string_match::score_t aNameScoreThreshold)
         {
-            const auto antigen_name = mAntigen->name();
-            mName = string_match::match(antigen_name, name);
+            mName = string_match::match(mAntigen->name(), name);
+            preprocess_full(name, aNameScoreThreshold);
+        }
+
+    inline void preprocess_full(std::string name, string_match::score_t aNameScoreThreshold)
+        {
             if (aNameScoreThreshold == 0)
                 aNameScoreThreshold = static_cast<string_match::score_t>(name.length() * name.length() * 0.05);
             if (mName >= aNameScoreThreshold) {
                 using namespace _antigen_serum_match;
                 const auto full_name = mAntigen->full_name();
-                const auto name_part_size = static_cast<int>(antigen_name.size());
+                const auto name_part_size = static_cast<int>(mAntigen->name().size());
                 mFull = std::max({
                         for_subst(full_name, name_part_size, name, " CELL", sReCell, nullptr),
                         for_subst(full_name, name_part_size, name, " EGG", sReEgg, &sReReassortant),
@@ -0,0 +1,267 @@
+// Microbenchmarks on synthetic charts, results are written as JSON to track regressions.
+// Usage: acmacs-chart-bench [--output <file.json>] [--repeat <n>] [--label <text>] [--scenario <name>]...
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include <unistd.h>
+
+#include "synthetic-chart.hh"
+#include "chart.hh"
+#include "ace.hh"
+#include "lispmds.hh"
+#include "binary.hh"
+
+namespace fs = std::filesystem;
+
+// ----------------------------------------------------------------------
+
+static const std::vector<SyntheticChartParameters> sScenarios = {
+      // name             antigens  sera  sparse density layers projections
+    {"small",                 100,    20, false,   0.9,     0,          1},
+    {"medium",               2000,   200, false,   0.8,     0,         10},
+    {"many-projections",     1000,   100, false,   0.8,     0,        500},
+    {"large-dense",         20000,   200, false,   0.7,     0,          1},
+    {"large-sparse-layers", 20000,   500,  true,   0.05,   10,          1},
+    {"huge-sparse-layers",  50000,  1000,  true,   0.02,   20,          1},
+};
+
+// ----------------------------------------------------------------------
+
+template <typename Func> static inline double seconds(Func aFunc)
+{
+    const auto start = std::chrono::steady_clock::now();
+    aFunc();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+class Measurement
+{
+ public:
+    inline Measurement(std::string aName) : mName(aName) {}
+
+    inline void add(double aSeconds) { mSeconds.push_back(aSeconds); }
+    inline void error(std::string aError) { mError = aError; }
+
+    void write(std::ostream& aOutput) const;
+
+ private:
+    std::string mName;
+    std::vector<double> mSeconds;
+    std::string mError;
+
+}; // class Measurement
+
+class Scenario
+{
+ public:
+    inline Scenario(const SyntheticChartParameters& aParameters, size_t aRepeat) : mParameters(aParameters), mRepeat(aRepeat) {}
+
+      // aRun() returns seconds taken by the measured part, untimed preparation may precede it
+    template <typename Func> inline void measure(std::string aName, Func aRun, size_t aRepeat = 0)
+        {
+            std::cerr << "  " << mParameters.name << ' ' << aName << std::endl;
+            auto& measurement = mMeasurements.emplace_back(aName);
+            try {
+                for (size_t run = 0; run < (aRepeat ? aRepeat : mRepeat); ++run)
+                    measurement.add(aRun());
+            }
+            catch (std::exception& err) {
+                measurement.error(err.what());
+            }
+        }
+
+    void run(const fs::path& aWorkDir);
+    void write(std::ostream& aOutput) const;
+
+ private:
+    const SyntheticChartParameters& mParameters;
+    size_t mRepeat;
+    std::vector<Measurement> mMeasurements;
+
+}; // class Scenario
+
+// ----------------------------------------------------------------------
+
+static inline std::string json_string(std::string aSource)
+{
+    std::string result{"\""};
+    for (char c: aSource) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            result += c;
+    }
+    return result + "\"";
+}
+
+void Measurement::write(std::ostream& aOutput) const
+{
+    aOutput << json_string(mName) << ": {";
+    if (!mError.empty()) {
+        aOutput << "\"error\": " << json_string(mError) << '}';
+        return;
+    }
+    auto sorted = mSeconds;
+    std::sort(sorted.begin(), sorted.end());
+    const double median = sorted.empty() ? 0.0 : (sorted.size() % 2 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2.0);
+    aOutput << "\"runs\": " << sorted.size()
+            << ", \"min\": " << (sorted.empty() ? 0.0 : sorted.front())
+            << ", \"median\": " << median
+            << ", \"mean\": " << (sorted.empty() ? 0.0 : std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size()))
+            << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << '}';
+
+} // Measurement::write
+
+// ----------------------------------------------------------------------
+
+void Scenario::run(const fs::path& aWorkDir)
+{
+    std::unique_ptr<Chart> chart;
+    measure("generate", [&]() { return seconds([&]() { chart.reset(make_synthetic_chart(mParameters)); }); }, 1);
+    if (!chart)
+        return;
+
+    const auto ace_file = (aWorkDir / (mParameters.name + ".ace")).string();
+    measure("export_chart", [&]() { return seconds([&]() { export_chart(ace_file, *chart); }); });
+    measure("import_chart", [&]() { return seconds([&]() { delete import_chart(ace_file); }); });
+    const auto lispmds_file = (aWorkDir / (mParameters.name + ".save")).string();
+    measure("export_chart_lispmds", [&]() { return seconds([&]() { export_chart_lispmds(lispmds_file, *chart); }); });
+    std::string binary;
+    measure("export_chart_binary", [&]() { return seconds([&]() { binary = export_chart_binary(*chart); }); });
+    measure("import_chart_binary", [&]() { return seconds([&]() { delete import_chart_binary(binary); }); });
+
+    measure("compute_column_bases", [&]() {
+        ColumnBases column_bases;
+        return seconds([&]() { chart->compute_column_bases(MinimumColumnBasis{}, column_bases); });
+    });
+
+    measure("find_homologous_antigen_for_sera", [&]() {
+        Chart copy(*chart);
+        copy.sera();            // non-const access detaches sera from the original outside of the timed part
+        return seconds([&]() { copy.find_homologous_antigen_for_sera(); });
+    });
+
+      // serum N is raised against antigen N (see make_synthetic_chart)
+    chart->find_homologous_antigen_for_sera();
+    const size_t circles = std::min(chart->number_of_sera(), size_t{50});
+    measure("serum_circle_radius_x" + std::to_string(circles), [&]() {
+        return seconds([&]() {
+            for (size_t sr_no = 0; sr_no < circles; ++sr_no)
+                chart->serum_circle_radius(sr_no, sr_no, 0);
+        });
+    });
+
+    const Chart& source = *chart;
+    std::vector<std::string> names;
+    for (size_t ag_no = 0; ag_no < source.number_of_antigens(); ag_no += std::max(source.number_of_antigens() / 100, size_t{1}))
+        names.push_back(source.antigens()[ag_no].name());
+    measure("name_trigram_index", [&]() {
+        const Antigens antigens = source.antigens(); // copy has no cached indices
+        return seconds([&]() { antigens.name_trigram_index(); });
+    });
+    measure("find_by_name_matching_x" + std::to_string(names.size()), [&]() { return seconds([&]() { source.antigens().find_by_name_matching(names); }); });
+    measure("find_by_name_x" + std::to_string(names.size()), [&]() {
+        return seconds([&]() {
+            for (const auto& name: names)
+                source.antigens().find_by_name(name.substr(name.find('/') + 1));
+        });
+    });
+
+    measure("group_index", [&]() {
+        const Antigens antigens = source.antigens();
+        return seconds([&]() { antigens.group_index(); });
+    });
+    measure("geographic_filters", [&]() {
+        return seconds([&]() {
+            const auto& antigens = source.antigens();
+            antigens.select(Antigens::Filter::continent("ASIA") & ~Antigens::Filter::egg());
+            antigens.select(Antigens::Filter::country("AUSTRALIA") | Antigens::Filter::country("UNITED STATES OF AMERICA"));
+            antigens.continent("EUROPE");
+            antigens.country("SINGAPORE");
+        });
+    });
+
+    fs::remove(ace_file);
+    fs::remove(lispmds_file);
+
+} // Scenario::run
+
+// ----------------------------------------------------------------------
+
+void Scenario::write(std::ostream& aOutput) const
+{
+    aOutput << "    {\"name\": " << json_string(mParameters.name)
+            << ", \"antigens\": " << mParameters.antigens << ", \"sera\": " << mParameters.sera
+            << ", \"sparse\": " << (mParameters.sparse ? "true" : "false") << ", \"density\": " << mParameters.density
+            << ", \"layers\": " << mParameters.layers << ", \"projections\": " << mParameters.projections << ", \"seed\": " << mParameters.seed
+            << ",\n     \"benchmarks\": {";
+    for (auto measurement = mMeasurements.begin(); measurement != mMeasurements.end(); ++measurement) {
+        aOutput << (measurement == mMeasurements.begin() ? "\n" : ",\n") << "        ";
+        measurement->write(aOutput);
+    }
+    aOutput << "\n    }}";
+
+} // Scenario::write
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    std::string output_filename, label;
+    size_t repeat = 3;
+    std::vector<std::string> scenario_names;
+    for (int arg = 1; arg < argc; ++arg) {
+        const std::string option = argv[arg];
+        if (arg + 1 < argc && option == "--output")
+            output_filename = argv[++arg];
+        else if (arg + 1 < argc && option == "--repeat")
+            repeat = std::max(std::stoul(argv[++arg]), 1UL);
+        else if (arg + 1 < argc && option == "--label")
+            label = argv[++arg];
+        else if (arg + 1 < argc && option == "--scenario")
+            scenario_names.push_back(argv[++arg]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--output <file.json>] [--repeat <n>] [--label <text>] [--scenario <name>]...\n  scenarios:";
+            for (const auto& parameters: sScenarios)
+                std::cerr << ' ' << parameters.name;
+            std::cerr << '\n';
+            return 1;
+        }
+    }
+
+    const auto work_dir = fs::temp_directory_path() / ("acmacs-chart-bench." + std::to_string(getpid()));
+    fs::create_directories(work_dir);
+    std::vector<Scenario> scenarios;
+    for (const auto& parameters: sScenarios) {
+        if (scenario_names.empty() || std::find(scenario_names.begin(), scenario_names.end(), parameters.name) != scenario_names.end())
+            scenarios.emplace_back(parameters, repeat).run(work_dir);
+    }
+    fs::remove_all(work_dir);
+
+    std::ofstream output_file;
+    if (!output_filename.empty())
+        output_file.open(output_filename);
+    std::ostream& output = output_filename.empty() ? std::cout : output_file;
+    const auto now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    output << std::setprecision(6) << "{\"version\": 1, \"label\": " << json_string(label) << ", \"date\": " << json_string(date) << ", \"repeat\": " << repeat << ",\n \"scenarios\": [";
+    for (auto scenario = scenarios.begin(); scenario != scenarios.end(); ++scenario) {
+        output << (scenario == scenarios.begin() ? "\n" : ",\n");
+        scenario->write(output);
+    }
+    output << "\n]}\n";
+    return 0;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,454 @@
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "binary.hh"
+#include "chart.hh"
+#include "trace.hh"
+
+// ----------------------------------------------------------------------
+// magic, version, then chart components in a fixed order (see BinaryWriter::write(const Chart&))
+// sizes: uint64_t, strings: size + bytes, vectors of numbers: size + raw array,
+// enums: uint8_t, other vectors: size + elements
+
+static constexpr const uint32_t BinaryMagic = 0x31424341; // "ACB1" if byte order is little endian
+static constexpr const uint32_t BinaryVersion = 1;
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "index vectors are stored as raw arrays of uint64_t");
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+    class BinaryWriter
+    {
+     public:
+        inline BinaryWriter(std::string& aTarget) : mTarget(aTarget) {}
+
+        template <typename T> inline std::enable_if_t<std::is_arithmetic_v<T>> write(T aValue) { append(&aValue, sizeof(aValue)); }
+        inline void write_size(size_t aSize) { write(static_cast<uint64_t>(aSize)); }
+        template <typename E> inline void write_enum(E aValue) { write(static_cast<uint8_t>(aValue)); }
+        inline void write(std::string_view aValue) { write_size(aValue.size()); append(aValue.data(), aValue.size()); }
+        inline void write(const std::pair<std::string, std::string>& aValue) { write(aValue.first); write(aValue.second); }
+
+        template <typename T> inline void write(const std::vector<T>& aValues)
+            {
+                write_size(aValues.size());
+                if constexpr (std::is_arithmetic_v<T>) {
+                    append(aValues.data(), aValues.size() * sizeof(T));
+                }
+                else {
+                    for (const auto& value: aValues)
+                        write(value);
+                }
+            }
+
+        void write(const Chart& aChart);
+        void write(const ChartInfo& aInfo);
+        void write(const Antigen& aAntigen);
+        void write(const Serum& aSerum);
+        void write(const ChartTiters& aTiters);
+        void write(const Projection& aProjection);
+        void write(const ChartPlotSpec& aPlotSpec);
+        void write(const ChartPlotSpecStyle& aStyle);
+        void write(const LabelStyle& aStyle);
+
+     private:
+        std::string& mTarget;
+
+        inline void append(const void* aData, size_t aSize) { mTarget.append(static_cast<const char*>(aData), aSize); }
+
+    }; // class BinaryWriter
+
+// ----------------------------------------------------------------------
+
+    class BinaryReader
+    {
+     public:
+        inline BinaryReader(std::string_view aSource) : mCurrent(aSource.data()), mEnd(aSource.data() + aSource.size()) {}
+
+        inline bool at_end() const { return mCurrent == mEnd; }
+
+        template <typename T> inline std::enable_if_t<std::is_arithmetic_v<T>, T> read()
+            {
+                if constexpr (std::is_same_v<T, bool>) {
+                    return read<uint8_t>() != 0;
+                }
+                else {
+                    T value;
+                    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+                    return value;
+                }
+            }
+
+          // aElementSize: minimal number of bytes taken by an element, protects against huge allocations for corrupted data
+        inline size_t read_size(size_t aElementSize)
+            {
+                const auto size = read<uint64_t>();
+                if (size > static_cast<uint64_t>(mEnd - mCurrent) / aElementSize)
+                    throw BinaryChartReadError{"invalid size " + std::to_string(size)};
+                return static_cast<size_t>(size);
+            }
+
+        template <typename E> inline E read_enum(E aLast)
+            {
+                const auto value = read<uint8_t>();
+                if (value > static_cast<uint8_t>(aLast))
+                    throw BinaryChartReadError{"invalid enum value " + std::to_string(value)};
+                return static_cast<E>(value);
+            }
+
+        inline std::string_view read_string() { const auto size = read_size(1); return {take(size), size}; }
+        template <typename Target> inline void read(Target& aTarget, void (Target::*aSetter)(const char*, size_t)) { const auto value = read_string(); (aTarget.*aSetter)(value.data(), value.size()); }
+
+        template <typename T> inline std::enable_if_t<std::is_arithmetic_v<T>> read(T& aTarget) { aTarget = read<T>(); }
+        inline void read(std::string& aTarget) { aTarget = read_string(); }
+        inline void read(std::pair<std::string, std::string>& aTarget) { read(aTarget.first); read(aTarget.second); }
+
+        template <typename T> inline void read(std::vector<T>& aTarget)
+            {
+                if constexpr (std::is_arithmetic_v<T>) {
+                    const auto size = read_size(sizeof(T));
+                    aTarget.resize(size);
+                    if (size)
+                        std::memcpy(aTarget.data(), take(size * sizeof(T)), size * sizeof(T));
+                }
+                else {
+                    aTarget.resize(read_size(sizeof(uint64_t))); // each element starts with a size or a number at least
+                    for (auto& element: aTarget)
+                        read(element);
+                }
+            }
+
+        void read(Chart& aChart);
+        void read(ChartInfo& aInfo);
+        void read(Antigen& aAntigen);
+        void read(Serum& aSerum);
+        void read(ChartTiters& aTiters);
+        void read(Projection& aProjection);
+        void read(ChartPlotSpec& aPlotSpec);
+        void read(ChartPlotSpecStyle& aStyle);
+        void read(LabelStyle& aStyle);
+
+     private:
+        const char* mCurrent;
+        const char* mEnd;
+
+        inline const char* take(size_t aSize)
+            {
+                if (aSize > static_cast<size_t>(mEnd - mCurrent))
+                    throw BinaryChartReadError{"unexpected end of data"};
+                const char* result = mCurrent;
+                mCurrent += aSize;
+                return result;
+            }
+
+    }; // class BinaryReader
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+
+std::string export_chart_binary(const Chart& aChart)
+{
+    acmacs_chart_internal::TraceTimer trace_timer{"export_chart_binary"};
+    std::string result;
+    acmacs_chart_internal::BinaryWriter writer(result);
+    writer.write(BinaryMagic);
+    writer.write(BinaryVersion);
+    writer.write(aChart);
+    return result;
+
+} // export_chart_binary
+
+// ----------------------------------------------------------------------
+
+bool is_chart_binary(std::string_view aData)
+{
+    return aData.size() >= sizeof(BinaryMagic) && std::memcmp(aData.data(), &BinaryMagic, sizeof(BinaryMagic)) == 0;
+
+} // is_chart_binary
+
+// ----------------------------------------------------------------------
+
+Chart* import_chart_binary(std::string_view aData)
+{
+    if (!is_chart_binary(aData))
+        throw BinaryChartReadError{"cannot import chart: not a binary chart or byte order differs"};
+    acmacs_chart_internal::TraceTimer trace_timer{"import_chart_binary"};
+    acmacs_chart_internal::BinaryReader reader(aData);
+    reader.read<uint32_t>();    // magic
+    if (const auto version = reader.read<uint32_t>(); version != BinaryVersion)
+        throw BinaryChartReadError{"cannot import chart: unsupported binary format version " + std::to_string(version)};
+    auto chart = std::make_unique<Chart>();
+    try {
+        reader.read(*chart);
+    }
+    catch (BinaryChartReadError&) {
+        throw;
+    }
+    catch (std::exception& err) {
+        throw BinaryChartReadError{err.what()};
+    }
+    if (!reader.at_end())
+        throw BinaryChartReadError{"cannot import chart: unexpected data after the chart"};
+    chart->intern_annotations();
+    if (acmacs_chart_internal::trace_enabled())
+        acmacs_chart_internal::count(acmacs_chart_internal::Counter::TitersParsed, chart->titers().number_of_entries());
+    return chart.release();
+
+} // import_chart_binary
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const Chart& aChart)
+{
+    write(aChart.chart_info_for_json());
+    write(aChart.antigens());
+    write(aChart.sera());
+    write(aChart.titers());
+    write(aChart.column_bases_for_json());
+    write(aChart.projections());
+    write(aChart.plot_spec());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(Chart& aChart)
+{
+    read(aChart.chart_info());
+    read(aChart.antigens());
+    read(aChart.sera());
+    read(aChart.titers());
+    read(aChart.column_bases_for_json());
+    read(aChart.projections());
+    read(aChart.plot_spec());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const ChartInfo& aInfo)
+{
+    for (auto field: {&ChartInfo::mVirus, &ChartInfo::mVirusType, &ChartInfo::mAssay, &ChartInfo::mDate, &ChartInfo::mLab, &ChartInfo::mRbc, &ChartInfo::mName, &ChartInfo::mSubset})
+        write(aInfo.*field);
+    write_enum(aInfo.mType);
+    write(aInfo.mSources);
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(ChartInfo& aInfo)
+{
+    for (auto field: {&ChartInfo::mVirus, &ChartInfo::mVirusType, &ChartInfo::mAssay, &ChartInfo::mDate, &ChartInfo::mLab, &ChartInfo::mRbc, &ChartInfo::mName, &ChartInfo::mSubset})
+        read(aInfo.*field);
+    aInfo.mType = read_enum(ChartInfo::Genetic);
+    read(aInfo.mSources);
+    aInfo.invalidate_caches();
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const Antigen& aAntigen)
+{
+    write(aAntigen.name());
+    write(aAntigen.date_view());
+    write(aAntigen.lineage_view());
+    write(aAntigen.passage_view());
+    write(aAntigen.reassortant_view());
+    write(aAntigen.lab_id());
+    write(aAntigen.semantic_view());
+    write(aAntigen.annotations());
+    write(aAntigen.clades());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(Antigen& aAntigen)
+{
+    read(aAntigen, &Antigen::name);
+    read(aAntigen, &Antigen::date);
+    read(aAntigen, &Antigen::lineage);
+    read(aAntigen, &Antigen::passage);
+    read(aAntigen, &Antigen::reassortant);
+    read(aAntigen.lab_id());
+    read(aAntigen, &Antigen::semantic);
+    read(aAntigen.annotations());
+    read(aAntigen.clades());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const Serum& aSerum)
+{
+    write(aSerum.name());
+    write(aSerum.serum_id());
+    write(aSerum.lineage_view());
+    write(aSerum.passage_view());
+    write(aSerum.reassortant_view());
+    write(aSerum.semantic_view());
+    write(aSerum.annotations());
+    write(aSerum.homologous());
+    write(aSerum.serum_species_view());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(Serum& aSerum)
+{
+    read(aSerum, &Serum::name);
+    read(aSerum, &Serum::serum_id);
+    read(aSerum, &Serum::lineage);
+    read(aSerum, &Serum::passage);
+    read(aSerum, &Serum::reassortant);
+    read(aSerum, &Serum::semantic);
+    read(aSerum.annotations());
+    read(aSerum.homologous());
+    read(aSerum, &Serum::serum_species);
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const ChartTiters& aTiters)
+{
+    write(aTiters.list());
+    write(aTiters.dict());
+    write(aTiters.layers());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(ChartTiters& aTiters)
+{
+    read(aTiters.list());
+    read(aTiters.dict());
+    read(aTiters.layers());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const Projection& aProjection)
+{
+    write(aProjection.comment());
+    write(aProjection.layout_for_json());
+    write(aProjection.stress());
+    write(aProjection.minimum_column_basis_for_json());
+    write(aProjection.column_bases_for_json());
+    const auto& transformation = aProjection.transformation();
+    for (double value: {transformation.a, transformation.b, transformation.c, transformation.d})
+        write(value);
+    write(aProjection.gradient_multipliers());
+    write(aProjection.titer_multipliers());
+    write(aProjection.dodgy_titer_is_regular());
+    write(aProjection.stress_diff_to_stop());
+    write(aProjection.unmovable());
+    write(aProjection.disconnected());
+    write(aProjection.unmovable_in_last_dimension());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(Projection& aProjection)
+{
+    read(aProjection, &Projection::comment);
+    read(aProjection.layout_for_json());
+    aProjection.stress(read<double>());
+    read(aProjection, &Projection::minimum_column_basis);
+    read(aProjection.column_bases_for_json());
+    auto& transformation = aProjection.transformation();
+    for (double* value: {&transformation.a, &transformation.b, &transformation.c, &transformation.d})
+        read(*value);
+    read(aProjection.gradient_multipliers());
+    read(aProjection.titer_multipliers());
+    aProjection.dodgy_titer_is_regular(read<bool>());
+    aProjection.stress_diff_to_stop(read<double>());
+    read(aProjection.unmovable());
+    read(aProjection.disconnected());
+    read(aProjection.unmovable_in_last_dimension());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const ChartPlotSpec& aPlotSpec)
+{
+    write(aPlotSpec.drawing_order());
+    write(aPlotSpec.style_for_point());
+    write(aPlotSpec.styles());
+    write(aPlotSpec.shown_on_all());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(ChartPlotSpec& aPlotSpec)
+{
+    read(aPlotSpec.drawing_order());
+    read(aPlotSpec.style_for_point());
+    read(aPlotSpec.styles_for_json());
+    read(aPlotSpec.shown_on_all());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const ChartPlotSpecStyle& aStyle)
+{
+    write(aStyle.shown());
+    write(aStyle.fill_color());
+    write(aStyle.outline_color());
+    write(aStyle.outline_width());
+    write_enum(aStyle.shape());
+    write(aStyle.size());
+    write(aStyle.rotation());
+    write(aStyle.aspect());
+    write(aStyle.label());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(ChartPlotSpecStyle& aStyle)
+{
+    aStyle.shown(read<bool>());
+    read(aStyle, &ChartPlotSpecStyle::fill_color);
+    read(aStyle, &ChartPlotSpecStyle::outline_color);
+    aStyle.outline_width(read<double>());
+    aStyle.set_shape(read_enum(ChartPlotSpecStyle::Triangle));
+    aStyle.size(read<double>());
+    aStyle.rotation(read<double>());
+    aStyle.aspect(read<double>());
+    read(aStyle.label());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::BinaryWriter::write(const LabelStyle& aStyle)
+{
+    write(aStyle.shown());
+    write(aStyle.position());
+    write(aStyle.text());
+    write(aStyle.face());
+    write_enum(aStyle.slant());
+    write_enum(aStyle.weight());
+    write(aStyle.size());
+    write(aStyle.color());
+    write(aStyle.rotation());
+    write(aStyle.interline());
+
+} // acmacs_chart_internal::BinaryWriter::write
+
+void acmacs_chart_internal::BinaryReader::read(LabelStyle& aStyle)
+{
+    aStyle.shown(read<bool>());
+    read(aStyle.position());
+    read(aStyle, &LabelStyle::text);
+    read(aStyle, &LabelStyle::face);
+    aStyle.set_slant(read_enum(LabelStyle::Slant::Oblique));
+    aStyle.set_weight(read_enum(LabelStyle::Weight::Bold));
+    aStyle.size(read<double>());
+    read(aStyle, &LabelStyle::color);
+    aStyle.rotation(read<double>());
+    aStyle.interline(read<double>());
+
+} // acmacs_chart_internal::BinaryReader::read
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
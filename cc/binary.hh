@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+// ----------------------------------------------------------------------
+
+class Chart;
+
+class BinaryChartReadError : public std::runtime_error { public: using std::runtime_error::runtime_error; };
+
+  // Compact native serialization of the whole chart, used to pass charts between processes
+  // (pickling, shared memory). Numbers are stored in the native byte order, arrays of numbers
+  // (layouts, column bases, multipliers) as raw memory, the format is not meant for storage,
+  // use export_chart for that.
+std::string export_chart_binary(const Chart& aChart);
+
+  // aData is only read during the call, it may be a view of a shared memory block
+Chart* import_chart_binary(std::string_view aData);
+
+  // aData starts with the magic of the binary format
+bool is_chart_binary(std::string_view aData);
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
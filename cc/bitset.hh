@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Fixed size set of antigen/serum indices, one bit per index.
+      // Set operations are done 64 indices at a time.
+    class Bitset
+    {
+     public:
+        using Indices = std::vector<size_t>;
+
+        inline Bitset() = default;
+        inline Bitset(size_t aSize, bool aValue = false) : mSize{aSize}, mWords((aSize + 63) / 64, aValue ? ~uint64_t{0} : uint64_t{0}) { clear_tail(); }
+        inline Bitset(size_t aSize, const Indices& aIndices) : Bitset(aSize) { for (auto index: aIndices) set(index); }
+
+        inline size_t size() const { return mSize; }
+        inline bool test(size_t aIndex) const { return (mWords[aIndex / 64] >> (aIndex % 64)) & 1; }
+        inline bool operator[](size_t aIndex) const { return test(aIndex); }
+        inline void set(size_t aIndex) { mWords[aIndex / 64] |= uint64_t{1} << (aIndex % 64); }
+        inline void reset(size_t aIndex) { mWords[aIndex / 64] &= ~(uint64_t{1} << (aIndex % 64)); }
+
+        inline size_t count() const { size_t result = 0; for (auto word: mWords) result += static_cast<size_t>(__builtin_popcountll(word)); return result; }
+        inline bool any() const { return std::any_of(mWords.begin(), mWords.end(), [](auto word) { return word != 0; }); }
+        inline bool none() const { return !any(); }
+
+        inline Bitset& operator &= (const Bitset& aNother) { for (size_t no = 0; no < mWords.size(); ++no) mWords[no] &= aNother.mWords[no]; return *this; }
+        inline Bitset& operator |= (const Bitset& aNother) { for (size_t no = 0; no < mWords.size(); ++no) mWords[no] |= aNother.mWords[no]; return *this; }
+        inline Bitset& subtract(const Bitset& aNother) { for (size_t no = 0; no < mWords.size(); ++no) mWords[no] &= ~aNother.mWords[no]; return *this; }
+        inline Bitset& flip() { for (auto& word: mWords) word = ~word; clear_tail(); return *this; }
+
+        inline Bitset operator & (const Bitset& aNother) const { Bitset result{*this}; result &= aNother; return result; }
+        inline Bitset operator | (const Bitset& aNother) const { Bitset result{*this}; result |= aNother; return result; }
+        inline Bitset operator ~ () const { Bitset result{*this}; result.flip(); return result; }
+        inline bool operator == (const Bitset& aNother) const { return mSize == aNother.mSize && mWords == aNother.mWords; }
+        inline bool operator != (const Bitset& aNother) const { return !operator==(aNother); }
+
+          // sorted indices of set bits
+        inline Indices indices() const
+            {
+                Indices result;
+                result.reserve(count());
+                for (size_t word_no = 0; word_no < mWords.size(); ++word_no) {
+                    for (auto word = mWords[word_no]; word; word &= word - 1)
+                        result.push_back(word_no * 64 + static_cast<size_t>(__builtin_ctzll(word)));
+                }
+                return result;
+            }
+
+          // removes from aIndices entries that are not in this set
+        inline void filter(Indices& aIndices) const { aIndices.erase(std::remove_if(aIndices.begin(), aIndices.end(), [this](size_t aIndex) { return !test(aIndex); }), aIndices.end()); }
+
+     private:
+        size_t mSize = 0;
+        std::vector<uint64_t> mWords;
+
+        inline void clear_tail() { if (mSize % 64) mWords.back() &= (uint64_t{1} << (mSize % 64)) - 1; }
+
+    }; // class Bitset
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
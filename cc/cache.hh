@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Lazily built data derived from its owner (e.g. an index over antigens).
+      // Copy of the owner starts with an empty cache, the value is rebuilt on
+      // the first access. Building is guarded by mutex, concurrent const access is safe.
+      // aStamp identifies the state of the owner the value was built for (e.g. size and
+      // modification counter), the value is rebuilt when owner passes a different stamp.
+    template <typename T, typename Stamp = size_t> class Cache
+    {
+     public:
+        inline Cache() = default;
+        inline Cache(const Cache&) {}
+        inline Cache& operator=(const Cache&) { reset(); return *this; }
+
+        template <typename Maker> inline const T& get(const Stamp& aStamp, Maker aMaker) const
+            {
+                std::lock_guard<std::mutex> lock{mMutex};
+                if (!mValue || mStamp != aStamp) {
+                    mValue = std::make_unique<T>(aMaker());
+                    mStamp = aStamp;
+                }
+                return *mValue;
+            }
+
+        inline void reset() { std::lock_guard<std::mutex> lock{mMutex}; mValue.reset(); }
+
+     private:
+        mutable std::mutex mMutex;
+        mutable std::unique_ptr<T> mValue;
+        mutable Stamp mStamp{};
+
+    }; // class Cache<T, Stamp>
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
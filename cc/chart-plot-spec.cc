@@ -11,6 +11,7 @@ void ChartPlotSpec::clear()
     mStyleForPoint.clear();
     mStyles.clear();
     mShownOnAll.clear();
+    drop_style_index();
 
 } // ChartPlotSpec::clear
 
@@ -26,32 +27,86 @@ void ChartPlotSpec::reset(const Chart& aChart)
 
       // reference antigens
     ChartPlotSpecStyle ref_antigen("transparent", "black", ChartPlotSpecStyle::Circle, 1.5);
-    for(auto index: aChart.antigens().reference_indices())
-        set(index, ref_antigen);
+    set(aChart.antigens().reference_indices(), ref_antigen);
 
       // sera
     ChartPlotSpecStyle serum("transparent", "black", ChartPlotSpecStyle::Box, 1.5);
-    for(auto index: acmacs::incrementer(aChart.number_of_antigens(), aChart.number_of_points())) {
-        set(index, serum);
-    }
+    std::fill(mStyleForPoint.begin() + static_cast<std::ptrdiff_t>(aChart.number_of_antigens()), mStyleForPoint.end(), style_index(serum));
 
 } // ChartPlotSpec::reset
 
 // ----------------------------------------------------------------------
 
-void ChartPlotSpec::set(size_t aPointNo, const ChartPlotSpecStyle& aStyle)
+size_t ChartPlotSpec::style_index(const ChartPlotSpecStyle& aStyle)
+{
+    for (; mIndexedStyles < mStyles.size(); ++mIndexedStyles)
+        mStyleIndex.emplace(mStyles[mIndexedStyles].hash(), mIndexedStyles);
+
+    const auto hash = aStyle.hash();
+    const auto [first, last] = mStyleIndex.equal_range(hash);
+    size_t found = mStyles.size();
+    for (auto entry = first; entry != last; ++entry) {
+        if (entry->second < found && mStyles[entry->second] == aStyle) // the first one if mStyles has duplicates
+            found = entry->second;
+    }
+    if (found < mStyles.size())
+        return found;
+    mStyles.push_back(aStyle);
+    mStyleIndex.emplace(hash, mIndexedStyles);
+    return mIndexedStyles++;
+
+} // ChartPlotSpec::style_index
+
+// ----------------------------------------------------------------------
+
+void ChartPlotSpec::style(size_t aStyleNo, const ChartPlotSpecStyle& aStyle)
 {
-    auto found = std::find(mStyles.begin(), mStyles.end(), aStyle);
-    if (found == mStyles.end()) {
-        mStyles.push_back(aStyle);
-        found = mStyles.end() - 1;
+    auto& target = mStyles.at(aStyleNo);
+    if (aStyleNo < mIndexedStyles) {
+        const auto [first, last] = mStyleIndex.equal_range(target.hash());
+        for (auto entry = first; entry != last; ++entry) {
+            if (entry->second == aStyleNo) {
+                mStyleIndex.erase(entry);
+                break;
+            }
+        }
+        mStyleIndex.emplace(aStyle.hash(), aStyleNo);
     }
-    mStyleForPoint[aPointNo] = static_cast<size_t>(found - mStyles.begin());
+    target = aStyle;
+
+} // ChartPlotSpec::style
+
+// ----------------------------------------------------------------------
+
+void ChartPlotSpec::set(size_t aPointNo, const ChartPlotSpecStyle& aStyle)
+{
+    mStyleForPoint[aPointNo] = style_index(aStyle);
 
 } // ChartPlotSpec::set
 
 // ----------------------------------------------------------------------
 
+void ChartPlotSpec::set(const std::vector<size_t>& aPoints, const ChartPlotSpecStyle& aStyle)
+{
+    const auto index = style_index(aStyle);
+    for (auto point_no: aPoints)
+        mStyleForPoint[point_no] = index;
+
+} // ChartPlotSpec::set
+
+// ----------------------------------------------------------------------
+
+size_t ChartPlotSpec::heap_bytes() const
+{
+    using acmacs_chart_internal::heap_bytes;
+    size_t result = heap_bytes(mDrawingOrder) + heap_bytes(mStyleForPoint) + heap_bytes(mShownOnAll) + mStyles.capacity() * sizeof(ChartPlotSpecStyle);
+    for (const auto& style: mStyles)
+        result += style.heap_bytes();
+      // node: next pointer and value, plus bucket array
+    result += mStyleIndex.size() * (sizeof(void*) + sizeof(decltype(mStyleIndex)::value_type)) + mStyleIndex.bucket_count() * sizeof(void*);
+    return result;
+
+} // ChartPlotSpec::heap_bytes
 
 // ----------------------------------------------------------------------
 /// Local Variables:
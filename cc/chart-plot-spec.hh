@@ -2,12 +2,59 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <functional>
+#include <string_view>
 
 #include "acmacs-base/throw.hh"
 #include "acmacs-base/float.hh"
+#include "acmacs-base/color.hh"
+#include "acmacs-chart-1/string-pool.hh"
+#include "acmacs-chart-1/memory-usage.hh"
 
 class Chart;
 
+// ----------------------------------------------------------------------
+
+  // Colour parsed once when set, renderers and style comparisons use the packed value.
+  // The source text (name, #RRGGBB, transparent, ...) is pooled and kept for lossless export only.
+class PlotSpecColor
+{
+ public:
+    static constexpr const uint32_t Unrecognized = 0xFFFFFFFD; // text is not a colour known to Color, texts are compared instead
+
+    inline PlotSpecColor(std::string_view aText) { assign(aText); }
+
+    inline void assign(std::string_view aText)
+        {
+            mText.assign(aText);
+            mColor = Color(Unrecognized);
+            try {
+                if (aText == "T" || aText == "t" || aText == "TRANSPARENT") // abbreviations allowed by the ace format
+                    mColor = Color("transparent");
+                else if (!aText.empty())
+                    mColor = Color(std::string(aText));
+            }
+            catch (std::exception&) {
+                mColor = Color(Unrecognized);
+            }
+        }
+
+    inline Color color() const { return mColor; }
+    inline const std::string& text() const { return mText.str(); }
+
+    inline bool operator==(const PlotSpecColor& aNother) const { return mColor == aNother.mColor && (packed() != Unrecognized || mText == aNother.mText); }
+    inline bool operator!=(const PlotSpecColor& aNother) const { return !operator==(aNother); }
+    inline size_t hash() const { return packed(); }
+
+ private:
+    Color mColor;
+    acmacs_chart_internal::PooledString mText;
+
+    inline uint32_t packed() const { return static_cast<uint32_t>((mColor.alphaI() << 24) | mColor.rgbI()); }
+
+}; // class PlotSpecColor
+
 // ----------------------------------------------------------------------
 
 class LabelStyle
@@ -25,6 +72,18 @@ class LabelStyle
                     && float_equal(mRotation, aNother.mRotation) && float_equal(mInterline, aNother.mInterline);
         }
 
+      // floating point fields are compared with tolerance and therefore not hashed
+    inline size_t hash() const
+        {
+            size_t result = std::hash<std::string>{}(mText);
+            hash_combine(result, std::hash<std::string>{}(mFace));
+            hash_combine(result, mColor.hash());
+            hash_combine(result, (static_cast<size_t>(mShown) << 8) | (static_cast<size_t>(mSlant) << 4) | static_cast<size_t>(mWeight));
+            return result;
+        }
+
+    static inline void hash_combine(size_t& aSeed, size_t aValue) { aSeed ^= aValue + 0x9e3779b97f4a7c15ULL + (aSeed << 6) + (aSeed >> 2); }
+
     inline void shown(bool aShown) { mShown = aShown; }
     inline bool shown() const { return mShown; }
 
@@ -38,6 +97,7 @@ class LabelStyle
     inline std::string face() const { return mFace; }
 
     inline void slant(const char* str, size_t length) { mSlant = slant_from_string(str, length); }
+    inline void set_slant(Slant aSlant) { mSlant = aSlant; }
     inline Slant slant() const { return mSlant; }
     inline std::string slant_as_stirng() const
         {
@@ -53,6 +113,7 @@ class LabelStyle
         }
 
     inline void weight(const char* str, size_t length) { mWeight = weight_from_string(str, length); }
+    inline void set_weight(Weight aWeight) { mWeight = aWeight; }
     inline Weight weight() const { return mWeight; }
     inline std::string weight_as_stirng() const
         {
@@ -68,8 +129,9 @@ class LabelStyle
     inline void size(double aSize) { mSize = aSize; }
     inline double size() const { return mSize; }
 
-    inline void color(const char* str, size_t length) { mColor.assign(str, length); }
-    inline std::string color() const { return mColor; }
+    inline void color(const char* str, size_t length) { mColor.assign(std::string_view(str, length)); }
+    inline const std::string& color() const { return mColor.text(); } // text for export
+    inline Color color_raw() const { return mColor.color(); }
 
     inline void rotation(double aRotation) { mRotation = aRotation; }
     inline double rotation() const { return mRotation; }
@@ -77,6 +139,9 @@ class LabelStyle
     inline void interline(double aInterline) { mInterline = aInterline; }
     inline double interline() const { return mInterline; }
 
+      // colors are in StringPool
+    inline size_t heap_bytes() const { return acmacs_chart_internal::heap_bytes(mPosition) + acmacs_chart_internal::heap_bytes(mText) + acmacs_chart_internal::heap_bytes(mFace); }
+
  private:
     bool mShown;                   // "+"
     std::vector<double> mPosition; // "p": [0.0, 1.0] label position (2D only), list of two doubles, default is [0, 1] means under point
@@ -85,7 +150,7 @@ class LabelStyle
     Slant mSlant;                  // "S": "normal OR italic OR oblique", // font slant, default normal
     Weight mWeight;                // "W": "normal OR bold", // font weight, default normal
     double mSize;                  // "s": 1.0,           // size, default 1.0
-    std::string mColor;            // "c": "black",   // color, default black
+    PlotSpecColor mColor;          // "c": "black",   // color, default black
     double mRotation;              // "r": 0.0,       // rotation, default 0.0
     double mInterline;             // "i": 0.2, // addtional interval between lines as a fraction of line height, default - 0.2
 
@@ -131,16 +196,28 @@ class ChartPlotSpecStyle
                     && float_equal(mAspect, aNother.mAspect) && mLabel == aNother.mLabel;
         }
 
+      // consistent with operator==: equal styles have equal hashes
+    inline size_t hash() const
+        {
+            size_t result = mLabel.hash();
+            LabelStyle::hash_combine(result, mFillColor.hash());
+            LabelStyle::hash_combine(result, mOutlineColor.hash());
+            LabelStyle::hash_combine(result, (static_cast<size_t>(mShown) << 4) | static_cast<size_t>(mShape));
+            return result;
+        }
+
     inline void shown(bool aShown) { mShown = aShown; }
     inline bool shown() const { return mShown; }
 
-    inline void fill_color(const char* str, size_t length) { mFillColor.assign(str, length); }
-    inline void fill(std::string aColor) { mFillColor = aColor; }
-    inline std::string fill_color() const { return mFillColor; }
+    inline void fill_color(const char* str, size_t length) { mFillColor.assign(std::string_view(str, length)); }
+    inline void fill(std::string aColor) { mFillColor.assign(aColor); }
+    inline const std::string& fill_color() const { return mFillColor.text(); } // text for export
+    inline Color fill_raw() const { return mFillColor.color(); }
 
-    inline void outline_color(const char* str, size_t length) { mOutlineColor.assign(str, length); }
-    inline void outline(std::string aColor) { mOutlineColor = aColor; }
-    inline std::string outline_color() const { return mOutlineColor; }
+    inline void outline_color(const char* str, size_t length) { mOutlineColor.assign(std::string_view(str, length)); }
+    inline void outline(std::string aColor) { mOutlineColor.assign(aColor); }
+    inline const std::string& outline_color() const { return mOutlineColor.text(); } // text for export
+    inline Color outline_raw() const { return mOutlineColor.color(); }
 
     inline void outline_width(double aOutlineWidth) { mOutlineWidth = aOutlineWidth; }
     inline double outline_width() const { return mOutlineWidth; }
@@ -174,10 +251,12 @@ class ChartPlotSpecStyle
     inline LabelStyle& label() { return mLabel; }
     inline const LabelStyle& label() const { return mLabel; }
 
+    inline size_t heap_bytes() const { return mLabel.heap_bytes(); }
+
  private:
     bool mShown;               // "+"
-    std::string mFillColor;    //  "F": "fill color: #FF0000 or T[RANSPARENT] or color name (red, green, blue, etc.), default is transparent",
-    std::string mOutlineColor; // "O": "outline color: #000000 or T[RANSPARENT] or color name (red, green, blue, etc.), default is black",
+    PlotSpecColor mFillColor;    //  "F": "fill color: #FF0000 or T[RANSPARENT] or color name (red, green, blue, etc.), default is transparent",
+    PlotSpecColor mOutlineColor; // "O": "outline color: #000000 or T[RANSPARENT] or color name (red, green, blue, etc.), default is black",
     double mOutlineWidth;      // "o": 1.0,             // outline width, default 1.0
     Shape mShape;              // "S": "shape: C[IRCLE], B[OX], T[RIANGLE], default is circle",
     double mSize;              // "s": 1.0,             // size, default is 1.0
@@ -216,8 +295,13 @@ class ChartPlotSpec
     inline std::vector<size_t>& style_for_point() { return mStyleForPoint; }
     inline const std::vector<size_t>& style_for_point() const { return mStyleForPoint; }
 
-    inline std::vector<ChartPlotSpecStyle>& styles() { return mStyles; }
     inline const std::vector<ChartPlotSpecStyle>& styles() const { return mStyles; }
+      // for importers, the style index is rebuilt on the next set() or add_style()
+    inline std::vector<ChartPlotSpecStyle>& styles_for_json() { drop_style_index(); return mStyles; }
+      // mutators keep the style index in sync
+    inline void styles(std::vector<ChartPlotSpecStyle> aStyles) { drop_style_index(); mStyles = std::move(aStyles); }
+    void style(size_t aStyleNo, const ChartPlotSpecStyle& aStyle); // replaces style, points using it get the new one
+    inline size_t add_style(const ChartPlotSpecStyle& aStyle) { return style_index(aStyle); } // returns index of the equal style if there is one
 
     inline std::vector<size_t>& shown_on_all() { return mShownOnAll; }
     inline const std::vector<size_t>& shown_on_all() const { return mShownOnAll; }
@@ -235,15 +319,25 @@ class ChartPlotSpec
         }
 
     void set(size_t aPointNo, const ChartPlotSpecStyle& aStyle);
+      // style is looked up (or added) once for all points
+    void set(const std::vector<size_t>& aPoints, const ChartPlotSpecStyle& aStyle);
     void reset(const Chart& aChart);
 
+      // incl. estimated size of the style index
+    size_t heap_bytes() const;
+
  private:
     std::vector<size_t> mDrawingOrder;       // "d"
     std::vector<size_t> mStyleForPoint;      // "p"
     std::vector<ChartPlotSpecStyle> mStyles; // "P"
     std::vector<size_t> mShownOnAll;         // "s"
 
+    std::unordered_multimap<size_t, size_t> mStyleIndex; // style hash -> index in mStyles
+    size_t mIndexedStyles = 0;                           // mStyles before this are in mStyleIndex, styles_for_json() drops the index
+
+    inline void drop_style_index() { mStyleIndex.clear(); mIndexedStyles = 0; }
     void clear();
+    size_t style_index(const ChartPlotSpecStyle& aStyle);
 
 }; // class ChartPlotSpec
 
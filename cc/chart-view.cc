@@ -0,0 +1,242 @@
+#include "chart-view.hh"
+
+// ----------------------------------------------------------------------
+
+ChartView::ChartView(const Chart& aChart, const Indices& aAntigens, const Indices& aSera)
+    : mChart(aChart), mAntigenIndices(aAntigens), mSerumIndices(aSera), mViewPoint(aChart.number_of_points(), NotInView)
+{
+    for (size_t ag_no = 0; ag_no < mAntigenIndices.size(); ++ag_no) {
+        if (mAntigenIndices[ag_no] >= mChart.number_of_antigens())
+            throw std::out_of_range("ChartView: invalid antigen index " + std::to_string(mAntigenIndices[ag_no]));
+        if (auto& point_no = mViewPoint[mAntigenIndices[ag_no]]; point_no == NotInView)
+            point_no = ag_no;
+        else
+            throw std::invalid_argument("ChartView: duplicate antigen index " + std::to_string(mAntigenIndices[ag_no]));
+    }
+    for (size_t sr_no = 0; sr_no < mSerumIndices.size(); ++sr_no) {
+        if (mSerumIndices[sr_no] >= mChart.number_of_sera())
+            throw std::out_of_range("ChartView: invalid serum index " + std::to_string(mSerumIndices[sr_no]));
+        if (auto& point_no = mViewPoint[mChart.number_of_antigens() + mSerumIndices[sr_no]]; point_no == NotInView)
+            point_no = number_of_antigens() + sr_no;
+        else
+            throw std::invalid_argument("ChartView: duplicate serum index " + std::to_string(mSerumIndices[sr_no]));
+    }
+    for (const auto& projection: mChart.projections())
+        mProjections.emplace_back(*this, projection);
+
+} // ChartView::ChartView
+
+// ----------------------------------------------------------------------
+
+ChartView::Indices ChartView::view_points(const Indices& aParentPoints) const
+{
+    Indices result;
+    for (auto parent_point_no: aParentPoints) {
+        if (parent_point_no < mViewPoint.size()) {
+            if (const auto point_no = mViewPoint[parent_point_no]; point_no != NotInView)
+                result.push_back(point_no);
+        }
+    }
+    return result;
+
+} // ChartView::view_points
+
+// ----------------------------------------------------------------------
+
+std::vector<double> ChartView::column_bases_for_json() const
+{
+    const auto& parent = mChart.column_bases_for_json();
+    std::vector<double> result;
+    if (!parent.empty()) {
+        for (auto sr_no: mSerumIndices)
+            result.push_back(parent[sr_no]);
+    }
+    return result;
+
+} // ChartView::column_bases_for_json
+
+// ----------------------------------------------------------------------
+
+double ChartView::compute_column_basis(const MinimumColumnBasisBase& aMinimumColumnBasis, size_t aSerumNo) const
+{
+    const auto view_titers = titers();
+    size_t max_titer = 0;
+    for (size_t ag_no = 0; ag_no < number_of_antigens(); ++ag_no) {
+        const Titer titer = view_titers.get(ag_no, aSerumNo);
+        if (!titer.is_dont_care()) {
+            size_t value = titer.value();
+            if (titer.is_more_than())
+                value *= 2;
+            if (value > max_titer)
+                max_titer = value;
+        }
+    }
+    max_titer = std::max(max_titer, static_cast<size_t>(aMinimumColumnBasis));
+    return std::log2(max_titer / 10.0);
+
+} // ChartView::compute_column_basis
+
+// ----------------------------------------------------------------------
+
+void ChartView::compute_column_bases(const MinimumColumnBasisBase& aMinimumColumnBasis, ColumnBases& aColumnBases) const
+{
+    aColumnBases.resize(number_of_sera());
+    for (size_t sr_no = 0; sr_no < number_of_sera(); ++sr_no)
+        aColumnBases.set(sr_no, compute_column_basis(aMinimumColumnBasis, sr_no));
+
+} // ChartView::compute_column_bases
+
+// ----------------------------------------------------------------------
+
+Layout* acmacs_chart_internal::LayoutView::clone() const
+{
+    auto* result = new Layout{};
+    for (size_t point_no = 0; point_no < number_of_points(); ++point_no)
+        result->data().push_back(operator[](point_no));
+    return result;
+
+} // acmacs_chart_internal::LayoutView::clone
+
+// ----------------------------------------------------------------------
+
+const Coordinates& acmacs_chart_internal::LayoutView::operator[](size_t aIndex) const
+{
+    static const Coordinates disconnected;
+    const auto parent_point_no = mView.parent_point(aIndex);
+    return parent_point_no < mParent.number_of_points() ? mParent[parent_point_no] : disconnected;
+
+} // acmacs_chart_internal::LayoutView::operator[]
+
+// ----------------------------------------------------------------------
+
+size_t acmacs_chart_internal::LayoutView::number_of_points() const
+{
+    return mParent.empty() ? 0 : mView.number_of_points();
+
+} // acmacs_chart_internal::LayoutView::number_of_points
+
+// ----------------------------------------------------------------------
+
+double acmacs_chart_internal::ColumnBasesView::operator[](size_t aIndex) const
+{
+    return mParent[mView.serum_indices()[aIndex]];
+
+} // acmacs_chart_internal::ColumnBasesView::operator[]
+
+// ----------------------------------------------------------------------
+
+double acmacs_chart_internal::ColumnBasesView::at(size_t aIndex) const
+{
+    return mParent.at(mView.serum_indices().at(aIndex));
+
+} // acmacs_chart_internal::ColumnBasesView::at
+
+// ----------------------------------------------------------------------
+
+size_t acmacs_chart_internal::ColumnBasesView::size() const
+{
+    return mParent.empty() ? 0 : mView.number_of_sera();
+
+} // acmacs_chart_internal::ColumnBasesView::size
+
+// ----------------------------------------------------------------------
+
+std::vector<double> acmacs_chart_internal::ColumnBasesView::data() const
+{
+    std::vector<double> result(size());
+    for (size_t sr_no = 0; sr_no < result.size(); ++sr_no)
+        result[sr_no] = operator[](sr_no);
+    return result;
+
+} // acmacs_chart_internal::ColumnBasesView::data
+
+// ----------------------------------------------------------------------
+
+ProjectionView::ProjectionView(const ChartView& aView, const Projection& aParent)
+    : mView(aView), mParent(aParent), mLayout(aView, aParent.layout()), mColumnBases(aView, aParent.column_bases())
+{
+
+} // ProjectionView::ProjectionView
+
+// ----------------------------------------------------------------------
+
+template <typename T> static inline std::vector<T> per_point(const ChartView& aView, const std::vector<T>& aParent)
+{
+    std::vector<T> result;
+    if (!aParent.empty()) {
+        result.resize(aView.number_of_points());
+        for (size_t point_no = 0; point_no < result.size(); ++point_no) {
+            if (const auto parent_point_no = aView.parent_point(point_no); parent_point_no < aParent.size())
+                result[point_no] = aParent[parent_point_no];
+        }
+    }
+    return result;
+
+} // per_point
+
+std::vector<double> ProjectionView::gradient_multipliers() const
+{
+    return per_point(mView, mParent.gradient_multipliers());
+
+} // ProjectionView::gradient_multipliers
+
+std::vector<double> ProjectionView::titer_multipliers() const
+{
+    return per_point(mView, mParent.titer_multipliers());
+
+} // ProjectionView::titer_multipliers
+
+std::vector<size_t> ProjectionView::unmovable() const
+{
+    return mView.view_points(mParent.unmovable());
+
+} // ProjectionView::unmovable
+
+std::vector<size_t> ProjectionView::disconnected() const
+{
+    return mView.view_points(mParent.disconnected());
+
+} // ProjectionView::disconnected
+
+std::vector<size_t> ProjectionView::unmovable_in_last_dimension() const
+{
+    return mView.view_points(mParent.unmovable_in_last_dimension());
+
+} // ProjectionView::unmovable_in_last_dimension
+
+// ----------------------------------------------------------------------
+
+std::vector<size_t> ChartPlotSpecView::drawing_order() const
+{
+    return mView.view_points(mParent.drawing_order());
+
+} // ChartPlotSpecView::drawing_order
+
+// ----------------------------------------------------------------------
+
+std::vector<size_t> ChartPlotSpecView::style_for_point() const
+{
+    return per_point(mView, mParent.style_for_point());
+
+} // ChartPlotSpecView::style_for_point
+
+// ----------------------------------------------------------------------
+
+std::vector<size_t> ChartPlotSpecView::shown_on_all() const
+{
+    return mView.view_points(mParent.shown_on_all());
+
+} // ChartPlotSpecView::shown_on_all
+
+// ----------------------------------------------------------------------
+
+const ChartPlotSpecStyle& ChartPlotSpecView::style_for(size_t aPointNo) const
+{
+    return mParent.style_for(mView.parent_point(aPointNo));
+
+} // ChartPlotSpecView::style_for
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <stdexcept>
+#include <deque>
+
+#include "acmacs-chart-1/chart.hh"
+
+// ----------------------------------------------------------------------
+
+class ChartView;
+
+class ChartViewReadOnly : public std::runtime_error { public: using std::runtime_error::runtime_error; };
+
+namespace acmacs_chart_internal
+{
+      // Antigens or sera of the parent chart selected by indices, read-only.
+    template <typename AgSr> class ChartViewEntries
+    {
+     public:
+        using Indices = std::vector<size_t>;
+
+        class const_iterator
+        {
+         public:
+            inline const_iterator(const ChartViewEntries& aEntries, size_t aIndex) : mEntries(aEntries), mIndex(aIndex) {}
+            inline const AgSr& operator*() const { return mEntries[mIndex]; }
+            inline const AgSr* operator->() const { return &mEntries[mIndex]; }
+            inline const_iterator& operator++() { ++mIndex; return *this; }
+            inline bool operator==(const const_iterator& aNother) const { return mIndex == aNother.mIndex; }
+            inline bool operator!=(const const_iterator& aNother) const { return mIndex != aNother.mIndex; }
+
+         private:
+            const ChartViewEntries& mEntries;
+            size_t mIndex;
+        };
+
+        inline ChartViewEntries(const std::vector<AgSr>& aParent, const Indices& aIndices) : mParent(aParent), mIndices(aIndices) {}
+
+        inline size_t size() const { return mIndices.size(); }
+        inline bool empty() const { return mIndices.empty(); }
+        inline const AgSr& operator[](size_t aIndex) const { return mParent[mIndices[aIndex]]; }
+        inline const_iterator begin() const { return {*this, 0}; }
+        inline const_iterator end() const { return {*this, size()}; }
+
+        inline Indices reference_indices() const
+            {
+                Indices result;
+                for (size_t index = 0; index < size(); ++index) {
+                    if ((*this)[index].reference())
+                        result.push_back(index);
+                }
+                return result;
+            }
+
+     private:
+        const std::vector<AgSr>& mParent;
+        const Indices& mIndices;
+
+    }; // class ChartViewEntries<AgSr>
+
+// ----------------------------------------------------------------------
+
+    class ChartViewTiters
+    {
+     public:
+        inline ChartViewTiters(const ChartView& aView) : mView(aView) {}
+
+        inline const ChartView& view() const { return mView; }
+        Titer get(size_t ag_no, size_t sr_no) const;
+        const ChartTiters& parent() const;
+
+     private:
+        const ChartView& mView;
+
+    }; // class ChartViewTiters
+
+// ----------------------------------------------------------------------
+
+    class LayoutView : public LayoutBase
+    {
+     public:
+        inline LayoutView(const ChartView& aView, const LayoutBase& aParent) : mView(aView), mParent(aParent) {}
+
+        Layout* clone() const override;
+        const Coordinates& operator[](size_t aIndex) const override;
+        [[noreturn]] inline void set(size_t, const Coordinates&) override { throw ChartViewReadOnly{"LayoutView::set: chart view is read-only"}; }
+        size_t number_of_points() const override;
+        inline size_t number_of_dimensions() const override { return mParent.number_of_dimensions(); }
+        inline bool empty() const override { return mParent.empty() || number_of_points() == 0; }
+
+     private:
+        const ChartView& mView;
+        const LayoutBase& mParent;
+
+    }; // class LayoutView
+
+// ----------------------------------------------------------------------
+
+      // Column bases stored in the parent projection (can be empty), remapped on access.
+    class ColumnBasesView : public ColumnBasesBase
+    {
+     public:
+        inline ColumnBasesView(const ChartView& aView, const ColumnBasesBase& aParent) : mView(aView), mParent(aParent) {}
+
+        [[noreturn]] inline void operator = (const ColumnBasesBase&) override { read_only(); }
+        double operator[](size_t aIndex) const override;
+        double at(size_t aIndex) const override;
+        [[noreturn]] inline void set(size_t, double) override { read_only(); }
+        [[noreturn]] inline void clear() override { read_only(); }
+        inline bool empty() const override { return mParent.empty(); }
+        size_t size() const override;
+        [[noreturn]] inline void resize(size_t) override { read_only(); }
+
+        std::vector<double> data() const;
+
+     private:
+        const ChartView& mView;
+        const ColumnBasesBase& mParent;
+
+        [[noreturn]] inline void read_only() const { throw ChartViewReadOnly{"ColumnBasesView: chart view is read-only"}; }
+
+    }; // class ColumnBasesView
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+
+class ProjectionView : public ProjectionBase
+{
+ public:
+    ProjectionView(const ChartView& aView, const Projection& aParent);
+    ProjectionView(const ProjectionView&) = delete;
+    ProjectionView& operator=(const ProjectionView&) = delete;
+
+    inline const Projection& parent() const { return mParent; }
+
+    inline std::string comment() const override { return mParent.comment(); }
+    [[noreturn]] inline LayoutBase& layout() override { throw ChartViewReadOnly{"ProjectionView::layout: chart view is read-only"}; }
+    inline const LayoutBase& layout() const override { return mLayout; }
+    inline double stress() const override { return mParent.stress(); }
+    inline const MinimumColumnBasisBase& minimum_column_basis() const override { return mParent.minimum_column_basis(); }
+    inline std::string minimum_column_basis_for_json() const { return mParent.minimum_column_basis_for_json(); }
+    inline const ColumnBasesBase& column_bases() const override { return mColumnBases; }
+    inline std::vector<double> column_bases_for_json() const { return mColumnBases.data(); }
+    inline const acmacs::Transformation& transformation() const override { return mParent.transformation(); }
+    [[noreturn]] inline void transformation(const acmacs::Transformation&) override { throw ChartViewReadOnly{"ProjectionView::transformation: chart view is read-only"}; }
+    inline bool dodgy_titer_is_regular() const override { return mParent.dodgy_titer_is_regular(); }
+    inline double stress_diff_to_stop() const override { return mParent.stress_diff_to_stop(); }
+
+      // per point values and point index lists of the parent remapped to the view points
+    std::vector<double> gradient_multipliers() const;
+    std::vector<double> titer_multipliers() const;
+    std::vector<size_t> unmovable() const;
+    std::vector<size_t> disconnected() const;
+    std::vector<size_t> unmovable_in_last_dimension() const;
+
+ private:
+    const ChartView& mView;
+    const Projection& mParent;
+    acmacs_chart_internal::LayoutView mLayout;
+    acmacs_chart_internal::ColumnBasesView mColumnBases;
+
+}; // class ProjectionView
+
+// ----------------------------------------------------------------------
+
+  // Plot spec of the parent with point indices remapped, styles are shared with the parent.
+class ChartPlotSpecView
+{
+ public:
+    inline ChartPlotSpecView(const ChartView& aView, const ChartPlotSpec& aParent) : mView(aView), mParent(aParent) {}
+
+    std::vector<size_t> drawing_order() const;
+    std::vector<size_t> style_for_point() const;
+    inline const std::vector<ChartPlotSpecStyle>& styles() const { return mParent.styles(); }
+    std::vector<size_t> shown_on_all() const;
+
+    inline bool empty() const { return mParent.empty(); }
+    const ChartPlotSpecStyle& style_for(size_t aPointNo) const;
+
+ private:
+    const ChartView& mView;
+    const ChartPlotSpec& mParent;
+
+}; // class ChartPlotSpecView
+
+// ----------------------------------------------------------------------
+
+  // Read-only subset of a chart: antigens and sera of the parent selected by indices.
+  // Nothing is copied, titers, layouts, column bases and plot spec are remapped on access.
+  // The parent must outlive the view and must not be modified while the view is in use.
+class ChartView : public ChartBase
+{
+ public:
+    using Indices = std::vector<size_t>;
+    static constexpr const size_t NotInView = static_cast<size_t>(-1);
+
+      // throws std::out_of_range for invalid and std::invalid_argument for repeated indices
+    ChartView(const Chart& aChart, const Indices& aAntigens, const Indices& aSera);
+    ChartView(const ChartView&) = delete;
+    ChartView& operator=(const ChartView&) = delete;
+
+    inline const Chart& chart() const { return mChart; }
+    inline const Indices& antigen_indices() const { return mAntigenIndices; }
+    inline const Indices& serum_indices() const { return mSerumIndices; }
+
+    inline size_t number_of_antigens() const override { return mAntigenIndices.size(); }
+    inline size_t number_of_sera() const override { return mSerumIndices.size(); }
+    inline size_t number_of_points() const { return number_of_antigens() + number_of_sera(); }
+
+      // point index in the parent for a point of the view and back, NotInView if parent point is not in the view
+    inline size_t parent_point(size_t aPointNo) const
+        {
+            return aPointNo < number_of_antigens() ? mAntigenIndices[aPointNo] : mChart.number_of_antigens() + mSerumIndices[aPointNo - number_of_antigens()];
+        }
+    inline size_t view_point(size_t aParentPointNo) const { return mViewPoint[aParentPointNo]; }
+    inline size_t view_antigen(size_t aParentAntigenNo) const { return view_point(aParentAntigenNo); }
+    inline size_t view_serum(size_t aParentSerumNo) const
+        {
+            const auto point_no = view_point(mChart.number_of_antigens() + aParentSerumNo);
+            return point_no == NotInView ? NotInView : point_no - number_of_antigens();
+        }
+      // aParentPoints filtered to the points of the view and remapped, order preserved
+    Indices view_points(const Indices& aParentPoints) const;
+
+    inline std::string lineage() const { return mChart.lineage(); }
+    inline const std::string make_name(size_t aProjectionNo = static_cast<size_t>(-1)) const { return mChart.make_name(aProjectionNo); }
+
+    inline const ChartInfoBase& chart_info() const override { return mChart.chart_info(); }
+    inline const ChartInfo& chart_info_for_json() const { return mChart.chart_info_for_json(); }
+
+    inline acmacs_chart_internal::ChartViewEntries<Antigen> antigens() const { return {mChart.antigens(), mAntigenIndices}; }
+    inline const AntigenBase& antigen(size_t ag_no) const override { return mChart.antigens()[mAntigenIndices[ag_no]]; }
+    inline acmacs_chart_internal::ChartViewEntries<Serum> sera() const { return {mChart.sera(), mSerumIndices}; }
+    inline const SerumBase& serum(size_t sr_no) const override { return mChart.sera()[mSerumIndices[sr_no]]; }
+      // sera() and serum() are the parent's objects, their homologous() refer to parent antigens,
+      // this one is remapped to antigens of the view, antigens not in the view are dropped
+    inline Indices homologous(size_t sr_no) const { return view_points(mChart.sera()[mSerumIndices[sr_no]].homologous()); }
+
+    inline acmacs_chart_internal::ChartViewTiters titers() const { return {*this}; }
+
+      // chart column bases (can be empty) remapped
+    std::vector<double> column_bases_for_json() const;
+      // computed for antigens of the view
+    double compute_column_basis(const MinimumColumnBasisBase& aMinimumColumnBasis, size_t aSerumNo) const;
+    void compute_column_bases(const MinimumColumnBasisBase& aMinimumColumnBasis, ColumnBases& aColumnBases) const;
+
+    inline const std::deque<ProjectionView>& projections() const { return mProjections; }
+    inline const ProjectionBase& projection(size_t aProjectionNo) const override { return mProjections[aProjectionNo]; }
+    inline size_t number_of_projections() const override { return mProjections.size(); }
+
+    inline ChartPlotSpecView plot_spec() const { return {*this, mChart.plot_spec()}; }
+
+ private:
+    const Chart& mChart;
+    const Indices mAntigenIndices;
+    const Indices mSerumIndices;
+    Indices mViewPoint;         // for each parent point: point index in the view or NotInView
+    std::deque<ProjectionView> mProjections; // deque: views are neither copyable nor movable
+
+}; // class ChartView
+
+// ----------------------------------------------------------------------
+
+inline Titer acmacs_chart_internal::ChartViewTiters::get(size_t ag_no, size_t sr_no) const
+{
+    return mView.chart().titers().get(mView.antigen_indices()[ag_no], mView.serum_indices()[sr_no]);
+}
+
+inline const ChartTiters& acmacs_chart_internal::ChartViewTiters::parent() const
+{
+    return mView.chart().titers();
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
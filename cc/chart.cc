@@ -1,12 +1,15 @@
 #include <set>
 #include <limits>
 #include <cmath>
+#include <atomic>
+#include <charconv>
 
 #include "acmacs-base/virus-name.hh"
 #include "acmacs-base/range.hh"
-#include "acmacs-base/enumerate.hh"
 
 #include "chart.hh"
+#include "parallel.hh"
+#include "trace.hh"
 
 #ifdef __clang__
 #pragma GCC diagnostic ignored "-Wexit-time-destructors"
@@ -14,12 +17,14 @@
 
 // ----------------------------------------------------------------------
 
+  // location abbreviation from the memoized locdb lookup, location itself if it is not in locdb
 static inline std::string name_abbreviated(std::string aName)
 {
     try {
         std::string virus_type, host, location, isolation, year, passage;
         virus_name::split(aName, virus_type, host, location, isolation, year, passage);
-        return string::join("/", {get_locdb().abbreviation(location), isolation, year.substr(2)});
+        const auto& abbreviation = acmacs_chart_internal::find_location(location).abbreviation;
+        return string::join("/", {abbreviation.empty() ? location : abbreviation, isolation, year.substr(2)});
     }
     catch (virus_name::Unrecognized&) {
         return aName;
@@ -92,15 +97,27 @@ std::string Serum::name_abbreviated() const
 
 // ----------------------------------------------------------------------
 
+  // empty string if location is unknown
+static inline std::string location_abbreviated(std::string aName)
+{
+    try {
+        return acmacs_chart_internal::find_location(virus_name::location(aName)).abbreviation;
+    }
+    catch (std::exception&) {
+        return {};
+    }
+
+} // location_abbreviated
+
 std::string Antigen::location_abbreviated() const
 {
-    return get_locdb().abbreviation(virus_name::location(name()));
+    return ::location_abbreviated(name());
 
 } // Antigen::location_abbreviated
 
 std::string Serum::location_abbreviated() const
 {
-    return get_locdb().abbreviation(virus_name::location(name()));
+    return ::location_abbreviated(name());
 
 } // Serum::location_abbreviated
 
@@ -160,16 +177,26 @@ AntigenSerumMatch Serum::match(const Serum& aNother) const
 
 // ----------------------------------------------------------------------
 
+  // ignore serum specific annotations (CONC*, BOOSTED*, *BLEED)
+static inline Annotations without_serum_specific(const Annotations& aAnnotations)
+{
+    static const std::regex serum_specific {"(CONC|BOOSTED|BLEED)"};
+    Annotations filtered;
+    std::copy_if(aAnnotations.begin(), aAnnotations.end(), std::back_inserter(filtered), [](const auto& anno) -> bool { return !std::regex_search(anno, serum_specific); });
+    return filtered;
+
+} // without_serum_specific
+
 AntigenSerumMatch Serum::match(const Antigen& aNother) const
 {
     AntigenSerumMatch m = antigen_serum_match(*this, aNother);
     if (m < AntigenSerumMatch::Mismatch) {
-                  // ignore serum specific annotations (CONC*, BOOSTED*, *BLEED)
-        Annotations self_filtered;
-        static std::regex serum_specific {"(CONC|BOOSTED|BLEED)"};
-        static auto filter = [](const auto& anno) -> bool { return !std::regex_search(anno, serum_specific); };
-        std::copy_if(annotations().begin(), annotations().end(), std::back_inserter(self_filtered), filter);
-        if (self_filtered != aNother.annotations()) {
+        const auto& self_annotations = annotations();
+        const auto& another_annotations = aNother.annotations();
+        const bool mismatch = self_annotations.interned() && self_annotations.table_id() == another_annotations.table_id()
+                ? self_annotations.id_without_serum_specific() != another_annotations.id()
+                : without_serum_specific(self_annotations) != another_annotations;
+        if (mismatch) {
             m.add(AntigenSerumMatch::AnnotationMismatch);
         }
     }
@@ -177,6 +204,40 @@ AntigenSerumMatch Serum::match(const Antigen& aNother) const
 
 } // Serum::match
 
+// ----------------------------------------------------------------------
+
+AnnotationsTable::AnnotationsTable()
+{
+    static std::atomic<uint32_t> last_table_id{0};
+    mTableId = ++last_table_id;
+
+} // AnnotationsTable::AnnotationsTable
+
+// ----------------------------------------------------------------------
+
+void AnnotationsTable::intern(Annotations& aAnnotations)
+{
+    auto canonical = [](const Annotations& aSource) -> std::string {
+        std::vector<std::string> sorted(aSource.begin(), aSource.end());
+        std::sort(sorted.begin(), sorted.end());
+        return string::join("\n", sorted.begin(), sorted.end());
+    };
+
+    aAnnotations.mId = mSets.insert(canonical(aAnnotations));
+    if (aAnnotations.mId == mWithoutSerumSpecific.size()) { // new set
+        mWithoutSerumSpecific.push_back(aAnnotations.mId);
+        const auto without = mSets.insert(canonical(without_serum_specific(aAnnotations)));
+        if (without == mWithoutSerumSpecific.size()) // new set too, filtering it again gives the same set
+            mWithoutSerumSpecific.push_back(without);
+        mWithoutSerumSpecific[aAnnotations.mId] = without;
+    }
+    aAnnotations.mWithoutSerumSpecificId = mWithoutSerumSpecific[aAnnotations.mId];
+    aAnnotations.mDistinct = aAnnotations.has("DISTINCT");
+    aAnnotations.mTableId = mTableId;
+
+} // AnnotationsTable::intern
+
+
 // ----------------------------------------------------------------------
 
 AntigenSerumMatch Serum::match_passage(const AntigenSerumBase& aNother) const
@@ -196,103 +257,284 @@ AntigenSerumMatch Serum::match_passage(const AntigenSerumBase& aNother) const
 
 // ----------------------------------------------------------------------
 
-template <typename AgSr> void AntigensSera<AgSr>::find_by_name_matching(std::string aName, Indices& aIndices, string_match::score_t aScoreThreshold, bool aVerbose) const
+void Antigen::memory_usage(acmacs_chart_internal::MemoryUsage& aUsage) const
+{
+    using acmacs_chart_internal::heap_bytes;
+    aUsage["antigens.name"] += heap_bytes(mName);
+    aUsage["antigens.lineage"] += heap_bytes(mLineage);
+    aUsage["antigens.passage"] += heap_bytes(mPassage);
+    aUsage["antigens.reassortant"] += heap_bytes(mReassortant);
+    aUsage["antigens.date"] += heap_bytes(mDate);
+    aUsage["antigens.annotations"] += heap_bytes(mAnnotations);
+    aUsage["antigens.lab_id"] += heap_bytes(mLabId);
+    aUsage["antigens.clades"] += heap_bytes(mClades);
+
+} // Antigen::memory_usage
+
+// ----------------------------------------------------------------------
+
+void Serum::memory_usage(acmacs_chart_internal::MemoryUsage& aUsage) const
+{
+    using acmacs_chart_internal::heap_bytes;
+    aUsage["sera.name"] += heap_bytes(mName);
+    aUsage["sera.lineage"] += heap_bytes(mLineage);
+    aUsage["sera.passage"] += heap_bytes(mPassage);
+    aUsage["sera.reassortant"] += heap_bytes(mReassortant);
+    aUsage["sera.serum_species"] += heap_bytes(mSerumSpecies);
+    aUsage["sera.annotations"] += heap_bytes(mAnnotations);
+    aUsage["sera.serum_id"] += heap_bytes(mSerumId);
+    aUsage["sera.homologous"] += heap_bytes(mHomologous);
+
+} // Serum::memory_usage
+
+// ----------------------------------------------------------------------
+
+template <typename AgSr> const acmacs_chart_internal::NameTrigramIndex& AntigensSera<AgSr>::name_trigram_index() const
+{
+    return mNameTrigramIndex.get(this->cache_stamp(), [this]() {
+        acmacs_chart_internal::TraceTimer trace_timer{"name_trigram_index"};
+        std::vector<std::string> names(this->size());
+        std::transform(begin(), end(), names.begin(), [](const auto& entry) { return entry.name(); });
+        return acmacs_chart_internal::NameTrigramIndex(names);
+    });
+
+} // AntigensSera<AgSr>::name_trigram_index
+
+template <typename AgSr> const acmacs_chart_internal::NameSuffixIndex& AntigensSera<AgSr>::name_suffix_index() const
+{
+    return mNameSuffixIndex.get(this->cache_stamp(), [this]() {
+        std::vector<std::string> names(this->size());
+        std::transform(begin(), end(), names.begin(), [](const auto& entry) { return entry.name(); });
+        return acmacs_chart_internal::NameSuffixIndex(names);
+    });
+
+} // AntigensSera<AgSr>::name_suffix_index
+
+// ----------------------------------------------------------------------
+
+  // string_match scores a common chunk of n chars n*n. A name having at most aShared trigram positions
+  // of aName has common chunks longer than 2 chars of at most aShared + 2 chars in total, the best case
+  // is one such chunk and 2 char chunks (2 per char) over the rest of aName.
+static inline string_match::score_t shared_trigrams_score_bound(const std::string& aName, size_t aShared)
+{
+    const auto chunk = std::min(aShared + 2, aName.size());
+    return static_cast<string_match::score_t>(chunk * chunk + 2 * (aName.size() - chunk));
+
+} // shared_trigrams_score_bound
+
+  // Name scores are computed for distinct names, most shared trigrams first, until no remaining name can
+  // reach the best score found so far (or aScoreThreshold). If names sharing no looked up trigram can
+  // still reach it (short names, only common trigrams, no good match), all names are scored.
+  // Entries whose name has the best score (and at least aScoreThreshold) are then ranked by full name score,
+  // the result does not depend on the order of entries.
+template <typename AgSr> static void find_by_name_matching(const AntigensSera<AgSr>& aAgSr, std::string aName, std::vector<size_t>& aIndices, string_match::score_t aScoreThreshold, bool aVerbose)
 {
     using Score = AntigenSerumMatchScore<AgSr>;
 
+    const auto& trigram_index = aAgSr.name_trigram_index();
+    auto name_score = [&trigram_index,&aName](size_t aNameNo) {
+        acmacs_chart_internal::count(acmacs_chart_internal::Counter::NameMatches);
+        return string_match::match(trigram_index.name(aNameNo), aName);
+    };
+
+    size_t min_shared = 1;
+    while (min_shared < aName.size() && shared_trigrams_score_bound(aName, min_shared) < aScoreThreshold)
+        ++min_shared;
+    const auto candidates = trigram_index.candidates(aName, min_shared);
+
+    std::vector<std::pair<size_t, string_match::score_t>> name_scores; // name no, score
+    string_match::score_t best = 0;
+    auto reachable = [&](size_t aShared) { const auto threshold = std::max(best, aScoreThreshold); return threshold == 0 || shared_trigrams_score_bound(aName, aShared) >= threshold; };
+    for (const auto& [name_no, shared]: candidates.names) {
+        if (!reachable(shared + candidates.skipped))
+            break;
+        name_scores.emplace_back(name_no, name_score(name_no));
+        best = std::max(best, name_scores.back().second);
+    }
+    if (reachable(candidates.skipped)) {
+        std::sort(name_scores.begin(), name_scores.end());
+        std::vector<std::pair<size_t, string_match::score_t>> all_names(trigram_index.number_of_names());
+        for (size_t name_no = 0, scored = 0; name_no < all_names.size(); ++name_no) {
+            if (scored < name_scores.size() && name_scores[scored].first == name_no)
+                all_names[name_no] = name_scores[scored++];
+            else
+                all_names[name_no] = {name_no, name_score(name_no)};
+            best = std::max(best, all_names[name_no].second);
+        }
+        name_scores = std::move(all_names);
+    }
+
+      // zero threshold is replaced with the default one in AntigenSerumMatchScore
+    const auto threshold = std::max(best, aScoreThreshold);
+    std::vector<std::pair<size_t, string_match::score_t>> entries; // entry no, name score
+    for (const auto& [name_no, score]: name_scores) {
+        if (score >= threshold) {
+            for (auto entry_no: trigram_index.entries(name_no))
+                entries.emplace_back(entry_no, score);
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+
     std::vector<std::pair<size_t, string_match::score_t>> index_score;
-    string_match::score_t score_threshold = aScoreThreshold;
-    for (auto ag = begin(); ag != end(); ++ag) {
-        Score score{aName, *ag, score_threshold};
-        score_threshold = std::max(score.name_score(), score_threshold);
-        if (score.full_name_score())
-            index_score.emplace_back(static_cast<size_t>(ag - begin()), score.full_name_score());
-    }
-    std::sort(index_score.begin(), index_score.end(), [](const auto& a, const auto& b) -> bool { return a.second > b.second; });
+    for (const auto& [ag_no, score]: entries) {
+        Score full_score{aName, aAgSr[ag_no], threshold, score};
+        if (full_score.full_name_score())
+            index_score.emplace_back(ag_no, full_score.full_name_score());
+    }
+
+    std::stable_sort(index_score.begin(), index_score.end(), [](const auto& a, const auto& b) -> bool { return a.second > b.second; });
     for (const auto& is: index_score) {
         if (is.second < index_score.front().second)
             break;
           // if name contains CELL, EGG, WILDTYPE - match only corresponding passage/reassortant
-        if (! ((aName.find("CELL") != std::string::npos && at(is.first).is_egg()) || (aName.find("EGG") != std::string::npos && !at(is.first).is_egg()) || (aName.find("WILDTYPE") != std::string::npos && at(is.first).is_reassortant()))) {
+        if (! ((aName.find("CELL") != std::string::npos && aAgSr.at(is.first).is_egg()) || (aName.find("EGG") != std::string::npos && !aAgSr.at(is.first).is_egg()) || (aName.find("WILDTYPE") != std::string::npos && aAgSr.at(is.first).is_reassortant()))) {
             aIndices.push_back(is.first);
             if (aVerbose)
-                std::cerr << "DEBUG: find_by_name_matching \"" << aName << "\" --> " << is.first << " \"" << at(is.first).full_name() << "\" egg:" << at(is.first).is_egg() << " score:" << is.second << std::endl;
+                std::cerr << "DEBUG: find_by_name_matching \"" << aName << "\" --> " << is.first << " \"" << aAgSr.at(is.first).full_name() << "\" egg:" << aAgSr.at(is.first).is_egg() << " score:" << is.second << std::endl;
         }
     }
 
+} // find_by_name_matching
+
+template <typename AgSr> void AntigensSera<AgSr>::find_by_name_matching(std::string aName, Indices& aIndices, string_match::score_t aScoreThreshold, bool aVerbose) const
+{
+    acmacs_chart_internal::TraceTimer trace_timer{"find_by_name_matching"};
+    ::find_by_name_matching(*this, aName, aIndices, aScoreThreshold, aVerbose);
+
+} // AntigensSera<AgSr>::find_by_name_matching
+
+template <typename AgSr> std::vector<typename AntigensSera<AgSr>::Indices> AntigensSera<AgSr>::find_by_name_matching(const std::vector<std::string>& aNames, string_match::score_t aScoreThreshold) const
+{
+    acmacs_chart_internal::TraceTimer trace_timer{"find_by_name_matching"};
+    name_trigram_index();       // build index before starting threads
+    std::vector<Indices> result(aNames.size());
+    acmacs_chart_internal::parallel_for(aNames.size(), [&](size_t name_no) { ::find_by_name_matching(*this, aNames[name_no], result[name_no], aScoreThreshold, false); });
+    return result;
+
 } // AntigensSera<AgSr>::find_by_name_matching
 
 // ----------------------------------------------------------------------
 
-template <typename AgSr> void AntigensSera<AgSr>::filter_country(Indices& aIndices, std::string aCountry) const
+template <typename AgSr> const acmacs_chart_internal::FullNameIndex& AntigensSera<AgSr>::full_name_index() const
 {
-    auto not_in_country = [&](const auto& entry) -> bool {
-        try {
-            return get_locdb().country(virus_name::location(entry.name())) != aCountry;
-        }
-        catch (virus_name::Unrecognized&) {
-        }
-        catch (LocationNotFound&) {
-        }
-        return true;
-    };
-    remove(aIndices, not_in_country);
+    return mFullNameIndex.get(this->cache_stamp(), [this]() {
+        acmacs_chart_internal::FullNameIndex index(this->size());
+        for (size_t no = 0; no < this->size(); ++no)
+            index.emplace((*this)[no].full_name(), no); // emplace keeps the first entry for duplicated names
+        return index;
+    });
 
-} // AntigensSera<AgSr>::filter_country
+} // AntigensSera<AgSr>::full_name_index
 
 // ----------------------------------------------------------------------
 
-template <typename AgSr> class ContinentToIndices : public std::map<std::string, std::vector<size_t>>
+template <typename AgSr> std::optional<size_t> AntigensSera<AgSr>::find_by_full_name(std::string aFullName) const
 {
- public:
-    ContinentToIndices(const AntigensSera<AgSr>& aAgSr)
-        {
-            auto add = [this](size_t aIndex, std::string aContinent) {
-                this->emplace(aContinent, mapped_type{}).first->second.push_back(aIndex);
-            };
-
-            const auto& locdb = get_locdb(report_time::Yes);
-            for (auto [index, entry]: acmacs::enumerate(aAgSr)) {
-                try {
-                    add(index, locdb.continent(virus_name::location(entry.name())));
-                }
-                catch (std::exception&) {
-                    add(index, "UNKNOWN");
-                }
-            }
-        }
+    const auto& index = full_name_index();
+    if (const auto found = index.find(aFullName); found != index.end())
+        return found->second;
+    else
+        return {};
 
-}; // class ContinentToIndices<>
+} // AntigensSera<AgSr>::find_by_full_name
 
-template <typename AgSr> void AntigensSera<AgSr>::filter_continent(Indices& aIndices, std::string aContinent) const
+// ----------------------------------------------------------------------
+
+template <typename AgSr> std::vector<std::string> AntigensSera<AgSr>::full_names() const
 {
-    static const ContinentToIndices<AgSr> continent_to_indices(*this);
-    const auto continent_indices = continent_to_indices.find(aContinent);
-    if (continent_indices == continent_to_indices.end()) {
-        aIndices.clear();
-    }
-    else {
-        auto not_in_continent = [&](size_t aIndex) -> bool { return std::find(std::begin(continent_indices->second), std::end(continent_indices->second), aIndex) == std::end(continent_indices->second); };
-        aIndices.erase(std::remove_if(aIndices.begin(), aIndices.end(), not_in_continent), aIndices.end());
+    std::vector<std::string> result(this->size());
+    std::transform(begin(), end(), result.begin(), [](const auto& entry) { return entry.full_name(); });
+    return result;
+
+} // AntigensSera<AgSr>::full_names
+
+// ----------------------------------------------------------------------
+
+static inline FullNameMatch match_full_names(const std::vector<std::string>& aFullNames, const acmacs_chart_internal::FullNameIndex& aIndex)
+{
+    FullNameMatch result;
+    result.mapping.resize(aFullNames.size(), AntigenSerumNotFound);
+    for (size_t no = 0; no < aFullNames.size(); ++no) {
+        if (const auto found = aIndex.find(aFullNames[no]); found != aIndex.end()) {
+            result.found.push_back(no);
+            result.mapping[no] = found->second;
+        }
+        else
+            result.not_found.push_back(no);
     }
+    return result;
+
+} // match_full_names
+
+template <typename AgSr> FullNameMatch AntigensSera<AgSr>::match_full_names(const AntigensSera<AgSr>& aNother) const
+{
+    return ::match_full_names(full_names(), aNother.full_name_index());
+
+} // AntigensSera<AgSr>::match_full_names
 
-} // AntigensSera<AgSr>::filter_continent
+template <typename AgSr> std::vector<FullNameMatch> AntigensSera<AgSr>::match_full_names(const std::vector<const AntigensSera<AgSr>*>& aOthers) const
+{
+    const auto names = full_names();
+    std::vector<FullNameMatch> result(aOthers.size());
+    std::transform(aOthers.begin(), aOthers.end(), result.begin(), [&names](const auto* another) { return ::match_full_names(names, another->full_name_index()); });
+    return result;
+
+} // AntigensSera<AgSr>::match_full_names
+
+// ----------------------------------------------------------------------
 
-// template <typename AgSr> void AntigensSera<AgSr>::filter_continent(Indices& aIndices, std::string aContinent) const
-// {
-//     auto not_in_continent = [&](const auto& entry) -> bool {
-//         try {
-//             return get_locdb(report_time::Yes).continent(virus_name::location(entry.name())) != aContinent;
-//         }
-//         catch (virus_name::Unrecognized&) {
-//         }
-//         catch (LocationNotFound&) {
-//         }
-//         return true;
-//     };
-//     remove(aIndices, not_in_continent);
+template <typename AgSr> const acmacs_chart_internal::Locations& AntigensSera<AgSr>::locations() const
+{
+    return mLocations.get(this->cache_stamp(), [this]() {
+        std::vector<std::string> names(this->size());
+        std::transform(begin(), end(), names.begin(), [](const auto& entry) { return entry.name(); });
+        return acmacs_chart_internal::Locations(names);
+    });
+
+} // AntigensSera<AgSr>::locations
+
+// ----------------------------------------------------------------------
+
+  // groups existing for antigens only
+static inline void add_groups(acmacs_chart_internal::GroupIndex&, size_t, const Serum&)
+{
+}
+
+static inline void add_groups(acmacs_chart_internal::GroupIndex& aIndex, size_t aIndexNo, const Antigen& aAntigen)
+{
+    using Group = acmacs_chart_internal::GroupIndex::Group;
+    for (const auto& clade: aAntigen.clades())
+        aIndex.add(Group::Clade, clade, aIndexNo);
+    aIndex.add(Group::Attribute, aAntigen.reference() ? aIndex.Reference : aIndex.Test, aIndexNo);
+}
+
+template <typename AgSr> const acmacs_chart_internal::GroupIndex& AntigensSera<AgSr>::group_index() const
+{
+    return mGroupIndex.get(this->cache_stamp(), [this]() {
+        using Group = acmacs_chart_internal::GroupIndex::Group;
+        acmacs_chart_internal::TraceTimer trace_timer{"group_index"};
+        const auto& locs = locations();
+        acmacs_chart_internal::GroupIndex index(this->size());
+        for (size_t no = 0; no < this->size(); ++no) {
+            const auto& entry = (*this)[no];
+            index.add(Group::Continent, locs.continent(no), no); // "UNKNOWN" is a valid continent group
+            if (locs[no].country != locs.Unknown)
+                index.add(Group::Country, locs.country(no), no);
+            if (const auto lineage = entry.lineage(); !lineage.empty())
+                index.add(Group::Lineage, lineage, no);
+            index.add(Group::PassageType, entry.passage_type(), no);
+            if (entry.is_egg())
+                index.add(Group::Attribute, index.Egg, no);
+            if (entry.is_cell())
+                index.add(Group::Attribute, index.Cell, no);
+            if (entry.is_reassortant())
+                index.add(Group::Attribute, index.Reassortant, no);
+            add_groups(index, no, entry);
+        }
+        return index;
+    });
 
-// } // AntigensSera<AgSr>::filter_continent
+} // AntigensSera<AgSr>::group_index
 
 // ----------------------------------------------------------------------
 
@@ -301,31 +543,90 @@ template class AntigensSera<Serum>;
 
 // ----------------------------------------------------------------------
 
+const acmacs_chart_internal::LabIdIndex& Antigens::lab_id_index() const
+{
+    return mLabIdIndex.get(cache_stamp(), [this]() {
+        acmacs_chart_internal::LabIdIndex index;
+        for (auto ag = begin(); ag != end(); ++ag) {
+            const auto ag_no = static_cast<size_t>(ag - begin());
+            for (const auto& lab_id: ag->lab_id()) {
+                auto& indices = index[lab_id];
+                if (indices.empty() || indices.back() != ag_no) // the same lab id may be listed twice for an antigen
+                    indices.push_back(ag_no);
+            }
+        }
+        return index;
+    });
+
+} // Antigens::lab_id_index
+
+// ----------------------------------------------------------------------
+
 void Antigens::find_by_lab_id(std::string aLabId, Antigens::Indices& aAntigenIndices) const
 {
-    for (auto ag = begin(); ag != end(); ++ag) {
-        if (ag->has_lab_id(aLabId))
-            aAntigenIndices.push_back(static_cast<size_t>(ag - begin()));
-    }
+    const auto& index = lab_id_index();
+    if (const auto found = index.find(aLabId); found != index.end())
+        aAntigenIndices.insert(aAntigenIndices.end(), found->second.begin(), found->second.end());
 
 } // Antigens::find_by_lab_id
 
 // ----------------------------------------------------------------------
 
-void Antigens::continents(ContinentData& aContinentData, bool aExcludeReference) const
+std::vector<Antigens::Indices> Antigens::find_by_lab_ids(const std::vector<std::string>& aLabIds) const
 {
-    for (auto ag = begin(); ag != end(); ++ag) {
-        if (!aExcludeReference || !ag->reference()) {
-            try {
-                const std::string location = virus_name::location(ag->name());
-                const std::string continent = get_locdb().continent(location);
-                aContinentData[continent].push_back(static_cast<size_t>(ag - begin()));
-            }
-            catch (virus_name::Unrecognized&) {
-            }
-            catch (LocationNotFound&) {
-            }
+    const auto& index = lab_id_index();
+    std::vector<Indices> result(aLabIds.size());
+    for (size_t no = 0; no < aLabIds.size(); ++no) {
+        if (const auto found = index.find(aLabIds[no]); found != index.end())
+            result[no] = found->second;
+    }
+    return result;
+
+} // Antigens::find_by_lab_ids
+
+// ----------------------------------------------------------------------
+
+const acmacs_chart_internal::DateIndex& Antigens::date_index() const
+{
+    return mDateIndex.get(cache_stamp(), [this]() {
+        std::vector<acmacs_chart_internal::DateCode> codes(size());
+        std::transform(begin(), end(), codes.begin(), [](const auto& entry) { return entry.date_code(); });
+        return acmacs_chart_internal::DateIndex(codes);
+    });
+
+} // Antigens::date_index
+
+// ----------------------------------------------------------------------
+
+Antigens::Indices Antigens::date_range_indices(std::string first_date, std::string after_last_date) const
+{
+    const auto first_code = acmacs_chart_internal::date_code(first_date), after_last_code = acmacs_chart_internal::date_code(after_last_date);
+    Indices result;
+    if (first_code == acmacs_chart_internal::DateInvalid || after_last_code == acmacs_chart_internal::DateInvalid) { // bounds cannot be parsed, compare strings
+        result = all_indices();
+        remove(result, [&](const auto& entry) -> bool { return !entry.within_date_range(first_date, after_last_date, first_code, after_last_code); });
+    }
+    else {
+        const auto& index = date_index();
+        result = index.range(first_code, after_last_code);
+        for (auto no: index.invalid()) { // antigens with unparsable dates are compared as strings
+            if ((*this)[no].within_date_range(first_date, after_last_date, first_code, after_last_code))
+                result.push_back(no);
         }
+        std::sort(result.begin(), result.end());
+    }
+    return result;
+
+} // Antigens::date_range_indices
+
+// ----------------------------------------------------------------------
+
+void Antigens::continents(ContinentData& aContinentData, bool aExcludeReference) const
+{
+    const auto& locs = locations();
+    for (size_t ag_no = 0; ag_no < size(); ++ag_no) {
+        if ((!aExcludeReference || !(*this)[ag_no].reference()) && locs[ag_no].continent != locs.Unknown)
+            aContinentData[locs.continent(ag_no)].push_back(ag_no);
     }
 
 } // Antigens::continents
@@ -334,18 +635,10 @@ void Antigens::continents(ContinentData& aContinentData, bool aExcludeReference)
 
 void Antigens::countries(CountryData& aCountries, bool aExcludeReference) const
 {
-    for (auto ag = begin(); ag != end(); ++ag) {
-        if (!aExcludeReference || !ag->reference()) {
-            try {
-                const std::string location = virus_name::location(ag->name());
-                const std::string country = get_locdb().country(location);
-                aCountries[country].push_back(static_cast<size_t>(ag - begin()));
-            }
-            catch (virus_name::Unrecognized&) {
-            }
-            catch (LocationNotFound&) {
-            }
-        }
+    const auto& locs = locations();
+    for (size_t ag_no = 0; ag_no < size(); ++ag_no) {
+        if ((!aExcludeReference || !(*this)[ag_no].reference()) && locs[ag_no].country != locs.Unknown)
+            aCountries[locs.country(ag_no)].push_back(ag_no);
     }
 
 } // Antigens::countries
@@ -368,30 +661,93 @@ std::string ChartInfo::merge_text_fields(std::string ChartInfo::* aMember) const
 
 // ----------------------------------------------------------------------
 
-const std::string ChartInfo::date() const
+ChartInfo::Merged ChartInfo::make_merged() const
 {
-    std::string result = mDate;
-    if (result.empty() && !mSources.empty()) {
+    Merged result;
+    result.virus = merge_text_fields(&ChartInfo::mVirus);
+    result.virus_type = merge_text_fields(&ChartInfo::mVirusType);
+    result.assay = merge_text_fields(&ChartInfo::mAssay);
+    result.lab = merge_text_fields(&ChartInfo::mLab);
+    if (result.assay.empty() || result.assay == "HI")
+        result.rbc = merge_text_fields(&ChartInfo::mRbc);
+    result.name = merge_text_fields(&ChartInfo::mName);
+    result.subset = merge_text_fields(&ChartInfo::mSubset);
+
+    result.date = mDate;
+    if (result.date.empty() && !mSources.empty()) {
         std::vector<std::string> data;
         for (const auto& src: mSources)
             data.push_back(src.mDate);
-        std::sort(data.begin(), data.end());
-        result = data.front() + "-" + data.back();
+        const auto [first, last] = std::minmax_element(data.begin(), data.end());
+        result.date = *first + "-" + *last;
     }
+
+    result.make_name = result.name;
+    if (result.make_name.empty())
+        result.make_name = string::join({result.lab, result.virus_type, result.assay, result.rbc, result.date});
     return result;
 
-} // ChartInfo::date
+} // ChartInfo::make_merged
 
 // ----------------------------------------------------------------------
 
-const std::string ChartInfo::make_name() const
+ChartInfo::SourceIndex ChartInfo::make_source_index() const
 {
-    std::string n = name();
-    if (n.empty())
-        n = string::join({lab(), virus_type(), assay(), rbc(), date()});
-    return n;
+    SourceIndex index;
+    for (size_t source_no = 0; source_no < mSources.size(); ++source_no) {
+        const auto& src = mSources[source_no];
+        index.by_date[src.date()].push_back(source_no);
+        index.by_lab[src.lab()].push_back(source_no);
+        index.by_assay[src.assay()].push_back(source_no);
+    }
+    return index;
+
+} // ChartInfo::make_source_index
+
+// ----------------------------------------------------------------------
+
+ChartInfo::Indices ChartInfo::sources_in_date_range(std::string aFirst, std::string aAfterLast) const
+{
+    const auto& by_date = source_index().by_date;
+    const auto first = aFirst.empty() ? by_date.begin() : by_date.lower_bound(aFirst);
+    const auto last = aAfterLast.empty() ? by_date.end() : by_date.lower_bound(aAfterLast);
+    Indices result;
+    for (auto entry = first; entry != last && (aAfterLast.empty() || entry->first < aAfterLast); ++entry)
+        result.insert(result.end(), entry->second.begin(), entry->second.end());
+    std::sort(result.begin(), result.end());
+    return result;
+
+} // ChartInfo::sources_in_date_range
+
+// ----------------------------------------------------------------------
+
+size_t ChartInfo::fields_heap_bytes() const
+{
+    using acmacs_chart_internal::heap_bytes;
+    return heap_bytes(mVirus) + heap_bytes(mVirusType) + heap_bytes(mAssay) + heap_bytes(mDate) + heap_bytes(mLab) + heap_bytes(mRbc) + heap_bytes(mName) + heap_bytes(mSubset);
+
+} // ChartInfo::fields_heap_bytes
 
-} // ChartInfo::make_name
+// ----------------------------------------------------------------------
+
+size_t ChartInfo::heap_bytes() const
+{
+    size_t result = fields_heap_bytes() + mSources.capacity() * sizeof(ChartInfo);
+    for (const auto& source: mSources)
+        result += source.heap_bytes();
+    return result;
+
+} // ChartInfo::heap_bytes
+
+// ----------------------------------------------------------------------
+
+void ChartInfo::memory_usage(acmacs_chart_internal::MemoryUsage& aUsage) const
+{
+    const size_t fields = fields_heap_bytes();
+    aUsage["chart_info"] += sizeof(ChartInfo) + fields;
+    aUsage["chart_info.sources"] += heap_bytes() - fields;
+
+} // ChartInfo::memory_usage
 
 // ----------------------------------------------------------------------
 
@@ -409,8 +765,44 @@ const std::string Chart::make_name(size_t aProjectionNo) const
 
 // ----------------------------------------------------------------------
 
+std::vector<FullNameMatch> Chart::match_antigens(const std::vector<const Chart*>& aOthers) const
+{
+    std::vector<const AntigensSera<Antigen>*> others(aOthers.size());
+    std::transform(aOthers.begin(), aOthers.end(), others.begin(), [](const Chart* chart) { return &chart->antigens(); });
+    return mAntigens->match_full_names(others);
+
+} // Chart::match_antigens
+
+std::vector<FullNameMatch> Chart::match_sera(const std::vector<const Chart*>& aOthers) const
+{
+    std::vector<const AntigensSera<Serum>*> others(aOthers.size());
+    std::transform(aOthers.begin(), aOthers.end(), others.begin(), [](const Chart* chart) { return &chart->sera(); });
+    return mSera->match_full_names(others);
+
+} // Chart::match_sera
+
+// ----------------------------------------------------------------------
+
+size_t ChartTiters::number_of_entries() const
+{
+    size_t result = 0;
+    for (const auto& row: mList)
+        result += row.size();
+    for (const auto& row: mDict)
+        result += row.size();
+    for (const auto& layer: mLayers) {
+        for (const auto& row: layer)
+            result += row.size();
+    }
+    return result;
+
+} // ChartTiters::number_of_entries
+
+// ----------------------------------------------------------------------
+
 Titer ChartTiters::get(size_t ag_no, size_t sr_no) const
 {
+    acmacs_chart_internal::count(acmacs_chart_internal::Counter::CellsAccessed);
     std::string result = "*";
     if (!mList.empty()) {
         result = mList[ag_no][sr_no];
@@ -428,6 +820,60 @@ Titer ChartTiters::get(size_t ag_no, size_t sr_no) const
 
 // ----------------------------------------------------------------------
 
+static inline void numeric_titer(const std::string& aTiter, double& aValue, ChartTiters::TiterType& aType)
+{
+    const char* first = aTiter.data();
+    const char* last = first + aTiter.size();
+    aType = ChartTiters::Regular;
+    if (first != last && *first == '<') {
+        aType = ChartTiters::LessThan;
+        ++first;
+    }
+    else if (first != last && *first == '>') {
+        aType = ChartTiters::MoreThan;
+        ++first;
+    }
+    unsigned long value = 0;
+    if (const auto [end, ec] = std::from_chars(first, last, value); first == last || ec != std::errc{} || end != last || value == 0) { // "*", empty or garbage
+        aType = ChartTiters::DontCare;
+        aValue = std::numeric_limits<double>::quiet_NaN();
+    }
+    else
+        aValue = std::log2(static_cast<double>(value) / 10.0);
+
+} // numeric_titer
+
+void ChartTiters::numeric(size_t aNumberOfAntigens, size_t aNumberOfSera, double* aValues, TiterType* aTypes, size_t aLayer) const
+{
+    acmacs_chart_internal::TraceTimer trace_timer{"ChartTiters::numeric"};
+    acmacs_chart_internal::count(acmacs_chart_internal::Counter::CellsAccessed, aNumberOfAntigens * aNumberOfSera);
+    std::fill(aValues, aValues + aNumberOfAntigens * aNumberOfSera, std::numeric_limits<double>::quiet_NaN());
+    std::fill(aTypes, aTypes + aNumberOfAntigens * aNumberOfSera, DontCare);
+
+    const Dict* dict = aLayer == NoLayer ? &mDict : &mLayers.at(aLayer);
+    const bool use_list = aLayer == NoLayer && !mList.empty();
+    const size_t number_of_rows = std::min(aNumberOfAntigens, use_list ? mList.size() : dict->size());
+    acmacs_chart_internal::parallel_for(number_of_rows, [&](size_t ag_no) {
+        double* values = aValues + ag_no * aNumberOfSera;
+        TiterType* types = aTypes + ag_no * aNumberOfSera;
+        if (use_list) {
+            const auto& row = mList[ag_no];
+            for (size_t sr_no = 0; sr_no < std::min(row.size(), aNumberOfSera); ++sr_no)
+                numeric_titer(row[sr_no], values[sr_no], types[sr_no]);
+        }
+        else {
+            for (const auto& [serum, titer]: (*dict)[ag_no]) {
+                size_t sr_no = 0;
+                if (std::from_chars(serum.data(), serum.data() + serum.size(), sr_no).ec == std::errc{} && sr_no < aNumberOfSera)
+                    numeric_titer(titer, values[sr_no], types[sr_no]);
+            }
+        }
+    }, 64);
+
+} // ChartTiters::numeric
+
+// ----------------------------------------------------------------------
+
 Titer ChartTiters::max_for_serum(size_t sr_no) const
 {
     Titer result;
@@ -445,7 +891,7 @@ Titer ChartTiters::max_for_serum(size_t sr_no) const
 std::string Chart::lineage() const
 {
     std::set<std::string> lineages;
-    for (const auto& antigen: mAntigens) {
+    for (const auto& antigen: *mAntigens) {
         if (!antigen.lineage().empty())
             lineages.insert(antigen.lineage());
     }
@@ -460,16 +906,31 @@ std::string Chart::lineage() const
 
 // ----------------------------------------------------------------------
 
+void Chart::intern_annotations()
+{
+    mAnnotationsTable = AnnotationsTable{}; // new table id, sets interned before are not compared with the new ones
+    for (auto& antigen: mAntigens.modify())
+        mAnnotationsTable.intern(antigen.annotations());
+    for (auto& serum: mSera.modify())
+        mAnnotationsTable.intern(serum.annotations());
+
+} // Chart::intern_annotations
+
+// ----------------------------------------------------------------------
+
 void Chart::find_homologous_antigen_for_sera()
 {
-    for (auto& serum: mSera) {
-        if (!serum.has_homologous()) { // it can be already set in .ace, e.g. manually during source excel sheet parsing
+    acmacs_chart_internal::TraceTimer trace_timer{"find_homologous_antigen_for_sera"};
+    const auto& antigens = *mAntigens;
+    for (size_t sr_no = 0; sr_no < number_of_sera(); ++sr_no) {
+        if (!(*mSera)[sr_no].has_homologous()) { // it can be already set in .ace, e.g. manually during source excel sheet parsing
+            auto& serum = mSera.modify()[sr_no]; // sera are copied only if there is anything to set and they are shared with another chart
               // std::cout << serum.full_name() << std::endl;
             std::vector<std::pair<size_t, AntigenSerumMatch>> antigen_match;
-            for (auto antigen = mAntigens.begin(); antigen != mAntigens.end(); ++antigen) {
+            for (auto antigen = antigens.begin(); antigen != antigens.end(); ++antigen) {
                 AntigenSerumMatch match{serum.match(*antigen)};
                 if (match.name_match())
-                    antigen_match.emplace_back(static_cast<size_t>(antigen - mAntigens.begin()), std::move(match));
+                    antigen_match.emplace_back(static_cast<size_t>(antigen - antigens.begin()), std::move(match));
             }
             switch (antigen_match.size()) {
               case 0:
@@ -481,33 +942,33 @@ void Chart::find_homologous_antigen_for_sera()
                   }
                   else {
                       std::cerr << "Warning: No homologous antigen for " << serum.full_name() << std::endl;
-                      std::cerr << "    the only name match: " << mAntigens[antigen_match.front().first].full_name() << " Level:" << antigen_match.front().second << std::endl;
+                      std::cerr << "    the only name match: " << antigens[antigen_match.front().first].full_name() << " Level:" << antigen_match.front().second << std::endl;
                   }
                   break;
               default:
                   // sort by AntigenSerumMatch but prefer reference antigens if matches are equal
-                std::sort(antigen_match.begin(), antigen_match.end(), [this](const auto& a, const auto& b) -> bool { return a.second == b.second ? mAntigens[a.first].reference() > mAntigens[b.first].reference() : a.second < b.second; });
+                std::sort(antigen_match.begin(), antigen_match.end(), [&antigens](const auto& a, const auto& b) -> bool { return a.second == b.second ? antigens[a.first].reference() > antigens[b.first].reference() : a.second < b.second; });
                 if (antigen_match.front().second.homologous_match()) {
                     for (const auto& match: antigen_match) {
                         if (match.second == antigen_match.front().second)
                             serum.add_homologous(match.first);
                     }
-                    // if (antigen_match.size() > 1 && antigen_match[0].second == antigen_match[1].second && mAntigens[antigen_match[0].first].reference() == mAntigens[antigen_match[1].first].reference()) {
+                    // if (antigen_match.size() > 1 && antigen_match[0].second == antigen_match[1].second && antigens[antigen_match[0].first].reference() == antigens[antigen_match[1].first].reference()) {
                     //     std::cerr << "Warning: Multiple homologous antigen candidates for " << serum.full_name() << " (the first one chosen)" << std::endl;
                     //     for (const auto ag: antigen_match) {
                     //         if (ag.second != antigen_match.front().second)
                     //             break;
-                    //         std::cerr << "    " << mAntigens[ag.first].full_name() << " Ref:" << mAntigens[ag.first].reference() << " Level:" << ag.second << std::endl;
+                    //         std::cerr << "    " << antigens[ag.first].full_name() << " Ref:" << antigens[ag.first].reference() << " Level:" << ag.second << std::endl;
                     //     }
                     // }
                 }
                 else {
                     std::cerr << "Warning: No homologous antigen for " << serum.full_name() << std::endl;
-                      // std::cerr << "    best match (of " << antigen_match.size() << "): " << mAntigens[antigen_match.front().first].full_name() << " Level:" << antigen_match.front().second << std::endl;
+                      // std::cerr << "    best match (of " << antigen_match.size() << "): " << antigens[antigen_match.front().first].full_name() << " Level:" << antigen_match.front().second << std::endl;
                     for (const auto& ag: antigen_match) {
                         if (ag.second != antigen_match.front().second)
                             break;
-                        std::cerr << "    " << mAntigens[ag.first].full_name() << " Ref:" << mAntigens[ag.first].reference() << " Level:" << ag.second << std::endl;
+                        std::cerr << "    " << antigens[ag.first].full_name() << " Ref:" << antigens[ag.first].reference() << " Level:" << ag.second << std::endl;
                     }
                 }
                 break;
@@ -566,6 +1027,7 @@ class SerumCircleRadiusCalculationError : public std::runtime_error { public: us
 
 double Chart::serum_circle_radius(size_t aAntigenNo, size_t aSerumNo, size_t aProjectionNo, bool aVerbose) const
 {
+    acmacs_chart_internal::TraceTimer trace_timer{"serum_circle_radius"};
     if (aVerbose)
         std::cerr << "DEBUG: serum_circle_radius for [sr:" << aSerumNo << ' ' << serum(aSerumNo).full_name() << "] [ag:" << aAntigenNo << ' ' << antigen(aAntigenNo).full_name() << ']' << std::endl;
     try {
@@ -682,6 +1144,58 @@ void Chart::serum_coverage(size_t aAntigenNo, size_t aSerumNo, std::vector<size_
 
 } // Chart::serum_coverage
 
+// ----------------------------------------------------------------------
+
+void Projection::memory_usage(acmacs_chart_internal::MemoryUsage& aUsage, std::string aPrefix) const
+{
+    using acmacs_chart_internal::heap_bytes;
+    aUsage[aPrefix + ".comment"] = heap_bytes(mComment);
+    aUsage[aPrefix + ".layout"] = sizeof(Layout) + heap_bytes(mLayout->data());
+    aUsage[aPrefix + ".column_bases"] = heap_bytes(mColumnBases.data());
+    aUsage[aPrefix + ".gradient_multipliers"] = sizeof(std::vector<double>) + heap_bytes(*mGradientMultipliers);
+    aUsage[aPrefix + ".titer_multipliers"] = sizeof(std::vector<double>) + heap_bytes(*mTiterMultipliers);
+    aUsage[aPrefix + ".point_lists"] = heap_bytes(mUnmovable) + heap_bytes(mDisconnected) + heap_bytes(mUnmovableInLastDimension);
+
+} // Projection::memory_usage
+
+// ----------------------------------------------------------------------
+
+acmacs_chart_internal::MemoryUsage Chart::memory_usage() const
+{
+    using acmacs_chart_internal::heap_bytes;
+    acmacs_chart_internal::MemoryUsage usage;
+    usage["chart"] = sizeof(Chart);
+
+    usage["antigens"] = sizeof(Antigens) + mAntigens->capacity() * sizeof(Antigen);
+    for (const auto& antigen: *mAntigens)
+        antigen.memory_usage(usage);
+    usage["sera"] = sizeof(Sera) + mSera->capacity() * sizeof(Serum);
+    for (const auto& serum: *mSera)
+        serum.memory_usage(usage);
+
+    usage["titers"] = sizeof(ChartTiters);
+    usage["titers.list"] = heap_bytes(mTiters->list());
+    usage["titers.dict"] = heap_bytes(mTiters->dict());
+    usage["titers.layers"] = heap_bytes(mTiters->layers());
+
+    usage["column_bases"] = sizeof(ColumnBases) + heap_bytes(mColumnBases->data());
+
+    usage["projections"] = sizeof(std::vector<Projection>) + mProjections->capacity() * sizeof(Projection);
+    for (size_t projection_no = 0; projection_no < mProjections->size(); ++projection_no)
+        (*mProjections)[projection_no].memory_usage(usage, "projections[" + std::to_string(projection_no) + "]");
+
+    usage["plot_spec"] = sizeof(ChartPlotSpec) + mPlotSpec->heap_bytes();
+    mInfo->memory_usage(usage);
+
+    size_t total = 0;
+    for (const auto& [component, bytes]: usage)
+        total += bytes;
+    usage["total"] = total;
+    usage["string_pool"] = acmacs_chart_internal::StringPool::memory_usage();
+    return usage;
+
+} // Chart::memory_usage
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
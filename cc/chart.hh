@@ -3,6 +3,7 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <optional>
 
 #include "acmacs-base/throw.hh"
@@ -14,36 +15,93 @@
 #include "acmacs-chart-1/layout.hh"
 #include "acmacs-chart-1/chart-plot-spec.hh"
 #include "acmacs-chart-1/chart-base.hh"
+#include "acmacs-chart-1/cache.hh"
+#include "acmacs-chart-1/copy-on-write.hh"
+#include "acmacs-chart-1/string-table.hh"
+#include "acmacs-chart-1/string-pool.hh"
+#include "acmacs-chart-1/name-index.hh"
+#include "acmacs-chart-1/locations.hh"
+#include "acmacs-chart-1/group-index.hh"
+#include "acmacs-chart-1/selection.hh"
+#include "acmacs-chart-1/date.hh"
+#include "acmacs-chart-1/memory-usage.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+    class BinaryWriter;
+    class BinaryReader;
+}
 
 // ----------------------------------------------------------------------
 
 class Annotations : public std::vector<std::string>
 {
  public:
+    using Id = acmacs_chart_internal::StringTable::Id;
+
     inline Annotations() = default;
 
     inline bool has(std::string anno) const { return std::find(begin(), end(), anno) != end(); }
-    inline bool distinct() const { return has("DISTINCT"); }
+    inline bool distinct() const { return interned() ? mDistinct : has("DISTINCT"); }
 
     inline void sort() { std::sort(begin(), end()); }
-    inline void sort() const { const_cast<Annotations*>(this)->sort(); }
 
     inline std::string join() const { return string::join(" ", begin(), end()); }
 
-      // note annotations has to be sorted (regardless of const) to compare
+      // set is interned if it was passed to AnnotationsTable::intern() and not modified since
+    inline bool interned() const { return mTableId != 0; }
+    inline uint32_t table_id() const { return mTableId; }
+    inline Id id() const { return mId; } // the same id for equal sets interned in the same table
+    inline Id id_without_serum_specific() const { return mWithoutSerumSpecificId; }
+    inline void reset_id() { mTableId = 0; }
+
+      // compared as sets regardless of order, integer compare if both are interned in the same table
     inline bool operator == (const Annotations& aNother) const
         {
-            bool equal = size() == aNother.size();
-            if (equal) {
-                sort();
-                aNother.sort();
-                equal = std::mismatch(begin(), end(), aNother.begin()).first == end();
-            }
-            return equal;
+            if (interned() && mTableId == aNother.mTableId)
+                return mId == aNother.mId;
+            if (size() != aNother.size())
+                return false;
+            if (size() < 2)
+                return std::equal(begin(), end(), aNother.begin());
+            std::vector<std::string> self_sorted(begin(), end()), another_sorted(aNother.begin(), aNother.end());
+            std::sort(self_sorted.begin(), self_sorted.end());
+            std::sort(another_sorted.begin(), another_sorted.end());
+            return self_sorted == another_sorted;
         }
+    inline bool operator != (const Annotations& aNother) const { return !operator==(aNother); }
+
+ private:
+    uint32_t mTableId = 0;              // 0 - not interned
+    Id mId = 0;
+    Id mWithoutSerumSpecificId = 0;     // id of the set without serum specific annotations (CONC*, BOOSTED*, *BLEED)
+    bool mDistinct = false;
+
+    friend class AnnotationsTable;
 
 }; // class Annotations
 
+// ----------------------------------------------------------------------
+
+  // Distinct annotation sets of a chart in canonical (sorted) form.
+  // Each table gets a process-wide unique id, ids of sets from different tables are never compared.
+class AnnotationsTable
+{
+ public:
+    AnnotationsTable();
+
+    void intern(Annotations& aAnnotations);
+    inline size_t size() const { return mSets.size(); }
+
+ private:
+    uint32_t mTableId;
+    acmacs_chart_internal::StringTable mSets;                       // canonical sets joined with '\n'
+    std::vector<Annotations::Id> mWithoutSerumSpecific;             // for each set: id of the set without serum specific annotations
+
+}; // class AnnotationsTable
+
 // ----------------------------------------------------------------------
 
 class Serum;
@@ -62,34 +120,49 @@ class Antigen : public AntigenBase
     inline const std::string name() const override { return mName; }
     inline std::string& name() { return mName; }
     inline void name(const char* str, size_t length) { mName.assign(str, length); }
+    inline std::string_view name_view() const { return mName; }
     inline const std::string lineage() const override { return mLineage; }
     inline std::string& lineage() { return mLineage; }
+    inline std::string_view lineage_view() const { return mLineage; }
     inline void lineage(const char* str, size_t length) { mLineage.assign(str, length); }
     inline const std::string passage() const override { return mPassage; }
     inline std::string& passage() { return mPassage; }
+    inline std::string_view passage_view() const { return mPassage; }
     inline void passage(const char* str, size_t length) { mPassage.assign(str, length); }
     inline bool has_passage() const override { return !mPassage.empty(); }
     inline std::string passage_without_date() const override { return acmacs::passage::without_date(mPassage); }
     inline const std::string reassortant() const override { return mReassortant; }
     inline std::string& reassortant() { return mReassortant; }
+    inline std::string_view reassortant_view() const { return mReassortant; }
     inline void reassortant(const char* str, size_t length) { mReassortant.assign(str, length); }
     inline bool is_egg() const override { return acmacs::passage::is_egg(mPassage) && !is_reassortant(); }
     inline bool is_reassortant() const override { return !mReassortant.empty(); }
     inline bool distinct() const override { return mAnnotations.distinct(); }
     inline const Annotations& annotations() const { return mAnnotations; }
-    inline Annotations& annotations() { return mAnnotations; }
+    inline Annotations& annotations() { mAnnotations.reset_id(); return mAnnotations; }
     inline bool has_semantic(char c) const { return mSemanticAttributes.find(c) != std::string::npos; }
     inline const std::string semantic() const { return mSemanticAttributes; }
+    inline std::string_view semantic_view() const { return mSemanticAttributes.view(); }
     inline void semantic(const char* str, size_t length) { mSemanticAttributes.assign(str, length); }
       // inline std::string passage_type() const { return is_egg() ? "egg" : "cell"; }
+      // locdb lookups are memoized per location (see find_location()), location_abbreviated() is empty if location is unknown
     std::string name_abbreviated() const;
     std::string location_abbreviated() const;
 
       // inline void name(const char* str, size_t length) { AntigenSerum::name(str, length); }
 
     inline const std::string date() const { return mDate; }
-    inline void date(const char* str, size_t length) { mDate.assign(str, length); }
-    inline bool within_date_range(std::string first_date, std::string after_last_date) const { return !date().empty() && (first_date.empty() || date() >= first_date) && (after_last_date.empty() || date() < after_last_date); }
+    inline std::string_view date_view() const { return mDate; }
+    inline void date(const char* str, size_t length) { mDate.assign(str, length); mDateCode = acmacs_chart_internal::date_code(str, length); }
+    inline acmacs_chart_internal::DateCode date_code() const { return mDateCode; }
+    inline bool within_date_range(std::string first_date, std::string after_last_date) const { return within_date_range(first_date, after_last_date, acmacs_chart_internal::date_code(first_date), acmacs_chart_internal::date_code(after_last_date)); }
+      // bounds are pre-parsed by the caller, strings are compared only if a date cannot be parsed
+    inline bool within_date_range(const std::string& first_date, const std::string& after_last_date, acmacs_chart_internal::DateCode first_code, acmacs_chart_internal::DateCode after_last_code) const
+        {
+            if (mDateCode > acmacs_chart_internal::DateMissing && first_code != acmacs_chart_internal::DateInvalid && after_last_code != acmacs_chart_internal::DateInvalid)
+                return (first_code == acmacs_chart_internal::DateMissing || mDateCode >= first_code) && (after_last_code == acmacs_chart_internal::DateMissing || mDateCode < after_last_code);
+            return !mDate.empty() && (first_date.empty() || mDate >= first_date) && (after_last_date.empty() || mDate < after_last_date);
+        }
 
     inline bool reference() const override { return has_semantic('R'); }
     inline const std::vector<std::string>& lab_id() const { return mLabId; }
@@ -103,14 +176,18 @@ class Antigen : public AntigenBase
     inline AntigenSerumMatch match(const AntigenSerumBase& aNother) const override { return match(static_cast<const Antigen&>(aNother)); }
     AntigenSerumMatch match_passage(const AntigenSerumBase& aNother) const override;
 
+      // heap memory of the fields not kept in StringPool, e.g. aUsage["antigens.name"]
+    void memory_usage(acmacs_chart_internal::MemoryUsage& aUsage) const;
+
  private:
     std::string mName; // "N" "[VIRUS_TYPE/][HOST/]LOCATION/ISOLATION/YEAR" or "CDC_ABBR NAME" or "NAME"
     std::string mLineage; // "L"
     std::string mPassage; // "P"
     std::string mReassortant; // "R"
     Annotations mAnnotations; // "a"
-    std::string mSemanticAttributes;       // string of single letter semantic boolean attributes: R - reference, V - current vaccine, v - previous vaccine, S - vaccine surrogate
+    acmacs_chart_internal::PooledString mSemanticAttributes; // string of single letter semantic boolean attributes: R - reference, V - current vaccine, v - previous vaccine, S - vaccine surrogate
     std::string mDate; // "D"
+    acmacs_chart_internal::DateCode mDateCode = acmacs_chart_internal::DateMissing; // parsed mDate
     std::vector<std::string> mLabId; // "l"
     std::vector<std::string> mClades; // "c"
 
@@ -130,26 +207,32 @@ class Serum : public SerumBase
     inline const std::string name() const override { return mName; }
     inline std::string& name() { return mName; }
     inline void name(const char* str, size_t length) { mName.assign(str, length); }
+    inline std::string_view name_view() const { return mName; }
     inline const std::string lineage() const override { return mLineage; }
     inline std::string& lineage() { return mLineage; }
+    inline std::string_view lineage_view() const { return mLineage; }
     inline void lineage(const char* str, size_t length) { mLineage.assign(str, length); }
     inline const std::string passage() const override { return mPassage; }
     inline std::string& passage() { return mPassage; }
+    inline std::string_view passage_view() const { return mPassage; }
     inline void passage(const char* str, size_t length) { mPassage.assign(str, length); }
     inline bool has_passage() const override { return !mPassage.empty(); }
     inline std::string passage_without_date() const override { return acmacs::passage::without_date(mPassage); }
     inline const std::string reassortant() const override { return mReassortant; }
     inline std::string& reassortant() { return mReassortant; }
+    inline std::string_view reassortant_view() const { return mReassortant; }
     inline void reassortant(const char* str, size_t length) { mReassortant.assign(str, length); }
     inline bool is_egg() const override { return acmacs::passage::is_egg(mPassage) || is_reassortant(); } // reassortant is always egg (2016-10-21)
     inline bool is_reassortant() const override { return !mReassortant.empty(); }
     inline bool distinct() const override { return mAnnotations.distinct(); }
     inline const Annotations& annotations() const { return mAnnotations; }
-    inline Annotations& annotations() { return mAnnotations; }
+    inline Annotations& annotations() { mAnnotations.reset_id(); return mAnnotations; }
     inline bool has_semantic(char c) const { return mSemanticAttributes.find(c) != std::string::npos; }
     inline const std::string semantic() const { return mSemanticAttributes; }
+    inline std::string_view semantic_view() const { return mSemanticAttributes.view(); }
     inline void semantic(const char* str, size_t length) { mSemanticAttributes.assign(str, length); }
       // inline std::string passage_type() const { return is_egg() ? "egg" : "cell"; }
+      // locdb lookups are memoized per location (see find_location()), location_abbreviated() is empty if location is unknown
     std::string name_abbreviated() const;
     std::string location_abbreviated() const;
 
@@ -158,6 +241,7 @@ class Serum : public SerumBase
     inline void serum_id(const char* str, size_t length) { mSerumId.assign(str, length); }
     inline const std::string serum_species() const { return mSerumSpecies; }
     inline std::string& serum_species() { return mSerumSpecies; }
+    inline std::string_view serum_species_view() const { return mSerumSpecies; }
     inline void serum_species(const char* str, size_t length) { mSerumSpecies.assign(str, length); }
 
     inline void add_homologous(size_t ag_no)
@@ -177,13 +261,16 @@ class Serum : public SerumBase
     inline AntigenSerumMatch match(const AntigenSerumBase& aNother) const override { return match(static_cast<const Serum&>(aNother)); }
     AntigenSerumMatch match_passage(const AntigenSerumBase& aNother) const override;
 
+      // heap memory of the fields not kept in StringPool, e.g. aUsage["sera.name"]
+    void memory_usage(acmacs_chart_internal::MemoryUsage& aUsage) const;
+
  private:
     std::string mName; // "N" "[VIRUS_TYPE/][HOST/]LOCATION/ISOLATION/YEAR" or "CDC_ABBR NAME" or "NAME"
     std::string mLineage; // "L"
     std::string mPassage; // "P"
     std::string mReassortant; // "R"
     Annotations mAnnotations; // "a"
-    std::string mSemanticAttributes;       // string of single letter semantic boolean attributes: R - reference, V - current vaccine, v - previous vaccine, S - vaccine surrogate
+    acmacs_chart_internal::PooledString mSemanticAttributes; // string of single letter semantic boolean attributes: R - reference, V - current vaccine, v - previous vaccine, S - vaccine surrogate
     std::string mSerumId; // "I"
     std::vector<size_t> mHomologous; // "h"
     std::string mSerumSpecies; // "s"
@@ -197,55 +284,129 @@ constexpr static const size_t AntigenSerumNotFound = static_cast<size_t>(-1);
 namespace acmacs_chart_internal
 {
     using Indices = std::vector<size_t>;
+    using FullNameIndex = std::unordered_map<std::string, size_t>; // full name to the index of the first antigen/serum with that name
+    using LabIdIndex = std::unordered_map<std::string, Indices>; // lab id to the sorted list of antigen indices
+}
 
-    template <typename AgSr> inline Indices find_by_name(const AgSr& aAgSr, std::string aName)
-    {
-        auto name_match = [&](size_t index) -> bool { return aAgSr[index].name().find(aName) != std::string::npos; };
-        Indices result(aAgSr.size());
-        result.erase(std::copy_if(acmacs::incrementer<size_t>::begin(0), acmacs::incrementer<size_t>::end(aAgSr.size()), result.begin(), name_match), result.end());
-        return result;
-    }
+// ----------------------------------------------------------------------
 
-    template <typename AgSr> inline std::optional<size_t> find_by_full_name(const AgSr& aAgSr, std::string aFullName)
-    {
-        auto name_match = [&](size_t index) -> bool { return aAgSr[index].full_name() == aFullName; };
-        const auto found = std::find_if(acmacs::incrementer<size_t>::begin(0), acmacs::incrementer<size_t>::end(aAgSr.size()), name_match);
-        if (*found == aAgSr.size())
-            return {};
-        else
-            return *found;
-    }
-}
+  // Result of matching antigens (sera) of one chart against antigens (sera) of another chart by full name
+class FullNameMatch
+{
+ public:
+    using Indices = std::vector<size_t>;
+
+    Indices found;              // indices (in the first chart) of entries found in another chart, sorted
+    Indices not_found;          // indices (in the first chart) of entries not found in another chart, sorted
+    Indices mapping;            // for each entry of the first chart: index of the same entry in another chart or AntigenSerumNotFound
+
+}; // class FullNameMatch
 
 // ----------------------------------------------------------------------
 
+  // Cached indices (names, locations, groups, ...) are rebuilt when the number of entries
+  // changes or after any non-const access to entries (operator[], at, begin, end, front, back, data),
+  // so entries may be edited in place. A reference obtained by non-const access must not be kept and
+  // used for editing after an index query, call invalidate_caches() if it is.
 template <typename AgSr> class AntigensSera : public std::vector<AgSr>
 {
  public:
     using Indices = std::vector<size_t>;
-    using std::vector<AgSr>::at;
-    using std::vector<AgSr>::begin;
-    using std::vector<AgSr>::end;
+    using Selection = acmacs_chart_internal::Selection;
+    using Filter = acmacs_chart_internal::SelectionFilter<AgSr>;
+    using Stamp = std::pair<size_t, size_t>; // number of entries, modification counter
+    using Base = std::vector<AgSr>;
 
     inline AntigensSera() {}
 
-    inline Indices find_by_name(std::string aName) const { return acmacs_chart_internal::find_by_name(*this, aName); }
-    inline std::optional<size_t> find_by_full_name(std::string aFullName) const { return acmacs_chart_internal::find_by_full_name(*this, aFullName); }
+    inline const AgSr& operator[](size_t aIndex) const { return Base::operator[](aIndex); }
+    inline AgSr& operator[](size_t aIndex) { modified(); return Base::operator[](aIndex); }
+    inline const AgSr& at(size_t aIndex) const { return Base::at(aIndex); }
+    inline AgSr& at(size_t aIndex) { modified(); return Base::at(aIndex); }
+    inline typename Base::const_iterator begin() const { return Base::begin(); }
+    inline typename Base::iterator begin() { modified(); return Base::begin(); }
+    inline typename Base::const_iterator end() const { return Base::end(); }
+    inline typename Base::iterator end() { modified(); return Base::end(); }
+    inline const AgSr& front() const { return Base::front(); }
+    inline AgSr& front() { modified(); return Base::front(); }
+    inline const AgSr& back() const { return Base::back(); }
+    inline AgSr& back() { modified(); return Base::back(); }
+    inline const AgSr* data() const { return Base::data(); }
+    inline AgSr* data() { modified(); return Base::data(); }
+
+    inline Indices find_by_name(std::string aName) const { return name_suffix_index().find(aName); }
+    const acmacs_chart_internal::NameSuffixIndex& name_suffix_index() const;
+    std::optional<size_t> find_by_full_name(std::string aFullName) const;
+    const acmacs_chart_internal::FullNameIndex& full_name_index() const;
+    std::vector<std::string> full_names() const;
+
+      // O(n+m): full names of aNother are hashed once (and cached in aNother)
+    FullNameMatch match_full_names(const AntigensSera<AgSr>& aNother) const;
+      // full names of this are built once and looked up in every chart of aOthers
+    std::vector<FullNameMatch> match_full_names(const std::vector<const AntigensSera<AgSr>*>& aOthers) const;
     void find_by_name_matching(std::string aName, Indices& aIndices, string_match::score_t aScoreThreshold = 0, bool aVerbose = false) const;
+      // matches many names in parallel, returns indices for each name in aNames
+    std::vector<Indices> find_by_name_matching(const std::vector<std::string>& aNames, string_match::score_t aScoreThreshold = 0) const;
+    const acmacs_chart_internal::NameTrigramIndex& name_trigram_index() const;
+
+      // location, country, continent of each entry, parsed and looked up in locdb once
+    const acmacs_chart_internal::Locations& locations() const;
+      // empty string if location of the entry is unknown
+    inline std::string location_abbreviated(size_t aIndex) const { const auto& locs = locations(); return locs[aIndex].abbreviation == locs.Unknown ? std::string{} : locs.abbreviation(aIndex); }
+
+      // continent, country, clade, lineage, passage type, reference/test groups as bitsets, built in one pass,
+      // rebuilt after entries are edited in place (see above), so select() never sees stale groups
+    const acmacs_chart_internal::GroupIndex& group_index() const;
+      // needed only if entries are modified through a reference kept since an earlier index query
+    inline void invalidate_caches() { modified(); }
 
     inline Indices all_indices() const { return acmacs::filled_with_indexes<Indices::value_type>(this->size()); }
-    void filter_country(Indices& aIndices, std::string aCountry) const;
-    void filter_continent(Indices& aIndices, std::string aContinent) const;
+      // filter expressions: e.g. select((Filter::egg() | Filter::reassortant()) & ~Filter::continent("EUROPE"))
+    inline Selection select(const Filter& aFilter) const { return aFilter.evaluate(*this, group_index()); }
+    inline void filter(Indices& aIndices, const Filter& aFilter) const { select(aFilter).filter(aIndices); }
+      // predicate called directly (no type erasure), result combines with select() results: select(Filter::egg()) & select_if(pred)
+    template <typename Pred> inline Selection select_if(Pred aPredicate) const
+        {
+            acmacs_chart_internal::Bitset result(this->size());
+            for (size_t no = 0; no < this->size(); ++no) {
+                if (aPredicate((*this)[no]))
+                    result.set(no);
+            }
+            return Selection(std::move(result));
+        }
+    inline void filter_country(Indices& aIndices, std::string aCountry) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Country, aCountry); }
+    inline void filter_continent(Indices& aIndices, std::string aContinent) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Continent, aContinent); }
+    inline void filter_lineage(Indices& aIndices, std::string aLineage) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Lineage, aLineage); }
 
-    inline Indices country(std::string aCountry) const  { auto indices = all_indices(); filter_country(indices, aCountry); return indices; }
-    inline Indices continent(std::string aContinent) const  { auto indices = all_indices(); filter_country(indices, aContinent); return indices; }
+    inline Indices country(std::string aCountry) const  { return group_indices(acmacs_chart_internal::GroupIndex::Group::Country, aCountry); }
+    inline Indices continent(std::string aContinent) const  { return group_indices(acmacs_chart_internal::GroupIndex::Group::Continent, aContinent); }
+    inline Indices lineage(std::string aLineage) const  { return group_indices(acmacs_chart_internal::GroupIndex::Group::Lineage, aLineage); }
 
  protected:
-    inline void remove(Indices& aIndices, std::function<bool (const AgSr&)> aFilter) const
+    template <typename Func> inline void remove(Indices& aIndices, Func aFilter) const
         {
             aIndices.erase(std::remove_if(aIndices.begin(), aIndices.end(), [&aFilter, this](auto index) -> bool { return aFilter((*this)[index]); }), aIndices.end());
         }
 
+    inline Indices group_indices(acmacs_chart_internal::GroupIndex::Group aGroup, std::string aName) const
+        {
+            if (const auto* found = group_index().find(aGroup, aName); found)
+                return found->indices();
+            return {};
+        }
+
+    inline Stamp cache_stamp() const { return {this->size(), mModifications}; }
+
+ private:
+    size_t mModifications = 0;
+    acmacs_chart_internal::Cache<acmacs_chart_internal::FullNameIndex, Stamp> mFullNameIndex;
+    acmacs_chart_internal::Cache<acmacs_chart_internal::NameTrigramIndex, Stamp> mNameTrigramIndex;
+    acmacs_chart_internal::Cache<acmacs_chart_internal::NameSuffixIndex, Stamp> mNameSuffixIndex;
+    acmacs_chart_internal::Cache<acmacs_chart_internal::Locations, Stamp> mLocations;
+    acmacs_chart_internal::Cache<acmacs_chart_internal::GroupIndex, Stamp> mGroupIndex;
+
+    inline void modified() { ++mModifications; }
+
 }; // class AntigensSera<AgSr>
 
 extern template class AntigensSera<Antigen>;
@@ -263,24 +424,39 @@ class Antigens : public AntigensSera<Antigen>
     using CountryData = std::map<std::string, Indices>; // country name to the list of antigen/serum indices
 
     void find_by_lab_id(std::string aLabId, Indices& aAntigenIndices) const;
+      // for each lab id in aLabIds: sorted indices of antigens having it
+    std::vector<Indices> find_by_lab_ids(const std::vector<std::string>& aLabIds) const;
+    const acmacs_chart_internal::LabIdIndex& lab_id_index() const;
     void continents(ContinentData& aContinentData, bool aExcludeReference = true) const;
     void countries(CountryData& aCountries, bool aExcludeReference = true) const;
 
-    inline void filter_reference(Indices& aIndices) const { remove(aIndices, [](const auto& entry) -> bool { return !entry.reference(); }); }
-    inline void filter_test(Indices& aIndices) const { remove(aIndices, [](const auto& entry) -> bool { return entry.reference(); }); }
-    inline void filter_egg(Indices& aIndices) const { remove(aIndices, [](const auto& entry) -> bool { return !entry.is_egg(); }); }
-    inline void filter_cell(Indices& aIndices) const { remove(aIndices, [](const auto& entry) -> bool { return !entry.is_cell(); }); }
-    inline void filter_reassortant(Indices& aIndices) const { remove(aIndices, [](const auto& entry) -> bool { return !entry.is_reassortant(); }); }
-    inline void filter_date_range(Indices& aIndices, std::string first_date, std::string after_last_date) const { remove(aIndices, [=](const auto& entry) -> bool { return !entry.within_date_range(first_date, after_last_date); }); }
-    inline void filter_found_in(Indices& aIndices, const Antigens& aNother) const { remove(aIndices, [&](const auto& entry) -> bool { return !aNother.find_by_full_name(entry.full_name()); }); }
-    inline void filter_not_found_in(Indices& aIndices, const Antigens& aNother) const { remove(aIndices, [&](const auto& entry) -> bool { return aNother.find_by_full_name(entry.full_name()).has_value(); }); }
-
-    inline Indices reference_indices() const { auto indices = all_indices(); filter_reference(indices); return indices; }
-    inline Indices test_indices() const { auto indices = all_indices(); filter_test(indices); return indices; }
-    inline Indices egg_indices() const { auto indices = all_indices(); filter_egg(indices); return indices; }
-    inline Indices cell_indices() const { auto indices = all_indices(); filter_cell(indices); return indices; }
-    inline Indices reassortant_indices() const { auto indices = all_indices(); filter_reassortant(indices); return indices; }
-    inline Indices date_range_indices(std::string first_date, std::string after_last_date) const { auto indices = all_indices(); filter_date_range(indices, first_date, after_last_date); return indices; }
+    inline void filter_reference(Indices& aIndices) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Reference); }
+    inline void filter_test(Indices& aIndices) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Test); }
+    inline void filter_egg(Indices& aIndices) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Egg); }
+    inline void filter_cell(Indices& aIndices) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Cell); }
+    inline void filter_reassortant(Indices& aIndices) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Reassortant); }
+    inline void filter_clade(Indices& aIndices, std::string aClade) const { group_index().filter(aIndices, acmacs_chart_internal::GroupIndex::Group::Clade, aClade); }
+    inline void filter_date_range(Indices& aIndices, std::string first_date, std::string after_last_date) const { acmacs_chart_internal::Bitset(size(), date_range_indices(first_date, after_last_date)).filter(aIndices); }
+    inline void filter_found_in(Indices& aIndices, const Antigens& aNother) const { const auto& index = aNother.full_name_index(); remove(aIndices, [&index](const auto& entry) -> bool { return index.find(entry.full_name()) == index.end(); }); }
+    inline void filter_not_found_in(Indices& aIndices, const Antigens& aNother) const { const auto& index = aNother.full_name_index(); remove(aIndices, [&index](const auto& entry) -> bool { return index.find(entry.full_name()) != index.end(); }); }
+
+    inline Indices reference_indices() const { return group_indices(acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Reference); }
+    inline Indices test_indices() const { return group_indices(acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Test); }
+    inline Indices egg_indices() const { return group_indices(acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Egg); }
+    inline Indices cell_indices() const { return group_indices(acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Cell); }
+    inline Indices reassortant_indices() const { return group_indices(acmacs_chart_internal::GroupIndex::Group::Attribute, acmacs_chart_internal::GroupIndex::Reassortant); }
+    inline Indices clade_indices(std::string aClade) const { return group_indices(acmacs_chart_internal::GroupIndex::Group::Clade, aClade); }
+    Indices date_range_indices(std::string first_date, std::string after_last_date) const;
+    inline static Filter date_range_filter(std::string first_date, std::string after_last_date)
+        {
+            const auto first_code = acmacs_chart_internal::date_code(first_date), after_last_code = acmacs_chart_internal::date_code(after_last_date);
+            return Filter::predicate([=](const auto& entry) -> bool { return entry.within_date_range(first_date, after_last_date, first_code, after_last_code); });
+        }
+    const acmacs_chart_internal::DateIndex& date_index() const;
+
+ private:
+    acmacs_chart_internal::Cache<acmacs_chart_internal::LabIdIndex, Stamp> mLabIdIndex;
+    acmacs_chart_internal::Cache<acmacs_chart_internal::DateIndex, Stamp> mDateIndex;
 
 }; // class Antigens
 
@@ -298,17 +474,28 @@ class Sera : public AntigensSera<Serum>
 class MinimumColumnBasis : public MinimumColumnBasisBase
 {
  public:
-    inline MinimumColumnBasis() : mValue{"none"}, mCached{static_cast<size_t>(-1)} {}
-    inline MinimumColumnBasis(const MinimumColumnBasis& aSrc) : MinimumColumnBasisBase{aSrc}, mValue{aSrc.mValue}, mCached{static_cast<size_t>(-1)} {}
-    inline operator size_t() const override { if (mCached == static_cast<decltype(mCached)>(-1)) mCached = mValue == "none" || mValue == "auto" ? 0 : std::stoul(mValue); return mCached; }
+    inline MinimumColumnBasis() : mValue{"none"}, mParsed{0} {}
+    inline operator size_t() const override { return mParsed != Invalid ? mParsed : std::stoul(mValue); } // invalid value: std::stoul throws
     inline operator std::string() const override { return mValue; }
-    inline void assign(const char* str, size_t length) { mValue.assign(str, length); mCached = static_cast<decltype(mCached)>(-1); }
+    inline void assign(const char* str, size_t length) { mValue.assign(str, length); mParsed = parse(mValue); }
 
     inline std::string data() const { return mValue; }
 
  private:
+    static constexpr const size_t Invalid = static_cast<size_t>(-1);
+
     std::string mValue;
-    mutable size_t mCached;
+    size_t mParsed;             // parsed on assignment, not lazily, to allow concurrent reading
+
+    static inline size_t parse(const std::string& aValue)
+        {
+            try {
+                return aValue == "none" || aValue == "auto" ? 0 : std::stoul(aValue);
+            }
+            catch (std::exception&) {
+                return Invalid;
+            }
+        }
 
 }; // class MinimumColumnBasis
 
@@ -346,10 +533,10 @@ class Projection : public ProjectionBase
     inline void comment(const char* str, size_t length) { mComment.assign(str, length); }
     inline std::string comment() const override { return mComment; }
 
-    inline LayoutBase& layout() override { return mLayout; }
-    inline const LayoutBase& layout() const override { return mLayout; }
-    inline std::vector<std::vector<double>>& layout_for_json() { return reinterpret_cast<std::vector<std::vector<double>>&>(mLayout.data()); }
-    inline const std::vector<Coordinates>& layout_for_json() const { return mLayout.data(); }
+    inline LayoutBase& layout() override { return mLayout.modify(); }
+    inline const LayoutBase& layout() const override { return *mLayout; }
+    inline std::vector<std::vector<double>>& layout_for_json() { return reinterpret_cast<std::vector<std::vector<double>>&>(mLayout.modify().data()); }
+    inline const std::vector<Coordinates>& layout_for_json() const { return mLayout->data(); }
 
     inline void stress(double aStress) { mStress = aStress; }
     inline double stress() const override { return mStress; }
@@ -367,11 +554,11 @@ class Projection : public ProjectionBase
     inline const acmacs::Transformation& transformation() const override { return mTransformation; }
     inline void transformation(const acmacs::Transformation& aTransformation) override { mTransformation = aTransformation; }
 
-    inline std::vector<double>& gradient_multipliers() { return mGradientMultipliers; }
-    inline const std::vector<double>& gradient_multipliers() const { return mGradientMultipliers; }
+    inline std::vector<double>& gradient_multipliers() { return mGradientMultipliers.modify(); }
+    inline const std::vector<double>& gradient_multipliers() const { return *mGradientMultipliers; }
 
-    inline std::vector<double>& titer_multipliers() { return mTiterMultipliers; }
-    inline const std::vector<double>& titer_multipliers() const { return mTiterMultipliers; }
+    inline std::vector<double>& titer_multipliers() { return mTiterMultipliers.modify(); }
+    inline const std::vector<double>& titer_multipliers() const { return *mTiterMultipliers; }
 
     inline void dodgy_titer_is_regular(bool aDodgyTiterIsRegular) { mDodgyTiterIsRegular = aDodgyTiterIsRegular; }
     inline bool dodgy_titer_is_regular() const override { return mDodgyTiterIsRegular; }
@@ -388,6 +575,9 @@ class Projection : public ProjectionBase
     inline std::vector<size_t>& unmovable_in_last_dimension() { return mUnmovableInLastDimension; }
     inline const std::vector<size_t>& unmovable_in_last_dimension() const { return mUnmovableInLastDimension; }
 
+      // keys are aPrefix + ".layout", ".column_bases", ..., layout and multipliers are counted in each projection sharing them
+    void memory_usage(acmacs_chart_internal::MemoryUsage& aUsage, std::string aPrefix) const;
+
     // inline size_t number_of_dimensions() const
     //     {
     //         for (const auto& point: mLayout) {
@@ -399,14 +589,14 @@ class Projection : public ProjectionBase
 
  private:
     std::string mComment;                           // "c"
-    Layout mLayout;       // "l": [[]] layout, list of lists of doubles, if point is disconnected: emtpy list or ?[NaN, NaN]
+    acmacs_chart_internal::CopyOnWrite<Layout> mLayout; // "l": [[]] layout, list of lists of doubles, if point is disconnected: emtpy list or ?[NaN, NaN]
       // size_t mNumberOfIterations;                // "i"
     double mStress;                                 // "s"
     MinimumColumnBasis mMinimumColumnBasis;         // "m": "1280", "none" (default)
     ColumnBases mColumnBases;                       // "C"
     acmacs::Transformation mTransformation;                 // "t": [1.0, 0.0, 0.0, 1.0]
-    std::vector<double> mGradientMultipliers;       // "g": [] double for each point
-    std::vector<double> mTiterMultipliers;          // "f": [],  antigens_sera_titers_multipliers, double for each point
+    acmacs_chart_internal::CopyOnWrite<std::vector<double>> mGradientMultipliers; // "g": [] double for each point
+    acmacs_chart_internal::CopyOnWrite<std::vector<double>> mTiterMultipliers;    // "f": [],  antigens_sera_titers_multipliers, double for each point
     bool mDodgyTiterIsRegular;                      // "d": false
     double mStressDiffToStop;                       // "e": 1e-10 - precise, 1e-5 - rough
     std::vector<size_t> mUnmovable;                 // "U": [] list of indices of unmovable points (antigen/serum attribute for stress evaluation)
@@ -421,19 +611,22 @@ class ChartInfo : public ChartInfoBase
 {
  public:
     enum TableType {Antigenic, Genetic};
+    using Indices = std::vector<size_t>;
+
     inline ChartInfo() : mType(Antigenic) {}
     inline ChartInfo(const ChartInfo&) = default;
     inline ChartInfo& operator=(const ChartInfo&) = default;
 //     std::string table_id(std::string lineage) const;
 
-    inline const std::string virus() const override { return merge_text_fields(&ChartInfo::mVirus); }
-    inline const std::string virus_type() const override { return merge_text_fields(&ChartInfo::mVirusType); }
-    inline const std::string assay() const override { return merge_text_fields(&ChartInfo::mAssay); }
-    const std::string date() const override;
-    inline const std::string lab() const override { return merge_text_fields(&ChartInfo::mLab); }
-    inline const std::string rbc() const override { const std::string ass = assay(); return ass.empty() || ass == "HI" ? merge_text_fields(&ChartInfo::mRbc) : std::string(); }
-    inline const std::string name() const override { return merge_text_fields(&ChartInfo::mName); }
-    inline const std::string subset() const override { return merge_text_fields(&ChartInfo::mSubset); }
+      // fields merged over sources are computed once, setters, *_ref() and non-const sources() invalidate them
+    inline const std::string virus() const override { return merged().virus; }
+    inline const std::string virus_type() const override { return merged().virus_type; }
+    inline const std::string assay() const override { return merged().assay; }
+    inline const std::string date() const override { return merged().date; }
+    inline const std::string lab() const override { return merged().lab; }
+    inline const std::string rbc() const override { return merged().rbc; }
+    inline const std::string name() const override { return merged().name; }
+    inline const std::string subset() const override { return merged().subset; }
     inline TableType type() const { return mType; }
     inline std::string type_as_string() const
         {
@@ -446,16 +639,16 @@ class ChartInfo : public ChartInfoBase
             return "?";         // to keep gcc happy
         }
 
-    const std::string make_name() const override;
+    inline const std::string make_name() const override { return merged().make_name; }
 
-    inline void virus(const char* str, size_t length) { mVirus.assign(str, length); }
-    inline void virus_type(const char* str, size_t length) { mVirusType.assign(str, length); }
-    inline void assay(const char* str, size_t length) { mAssay.assign(str, length); }
-    inline void date(const char* str, size_t length) { mDate.assign(str, length); }
-    inline void lab(const char* str, size_t length) { mLab.assign(str, length); }
-    inline void rbc(const char* str, size_t length) { mRbc.assign(str, length); }
-    inline void name(const char* str, size_t length) { mName.assign(str, length); }
-    inline void subset(const char* str, size_t length) { mSubset.assign(str, length); }
+    inline void virus(const char* str, size_t length) { mVirus.assign(str, length); invalidate_caches(); }
+    inline void virus_type(const char* str, size_t length) { mVirusType.assign(str, length); invalidate_caches(); }
+    inline void assay(const char* str, size_t length) { mAssay.assign(str, length); invalidate_caches(); }
+    inline void date(const char* str, size_t length) { mDate.assign(str, length); invalidate_caches(); }
+    inline void lab(const char* str, size_t length) { mLab.assign(str, length); invalidate_caches(); }
+    inline void rbc(const char* str, size_t length) { mRbc.assign(str, length); invalidate_caches(); }
+    inline void name(const char* str, size_t length) { mName.assign(str, length); invalidate_caches(); }
+    inline void subset(const char* str, size_t length) { mSubset.assign(str, length); invalidate_caches(); }
     inline void type(const char* str, size_t length) // reading from json
         {
             if (length != 1)
@@ -472,18 +665,31 @@ class ChartInfo : public ChartInfoBase
             }
         }
 
-    inline std::string& virus_ref() { return mVirus; }
-    inline std::string& virus_type_ref() { return mVirusType; }
-    inline std::string& assay_ref() { return mAssay; }
-    inline std::string& date_ref() { return mDate; }
-    inline std::string& lab_ref() { return mLab; }
-    inline std::string& rbc_ref() { return mRbc; }
-    inline std::string& name_ref() { return mName; }
-    inline std::string& subset_ref() { return mSubset; }
-
-    inline auto& sources() { return mSources; }
+      // returned reference must not be kept for modification after reading merged fields
+    inline std::string& virus_ref() { invalidate_caches(); return mVirus; }
+    inline std::string& virus_type_ref() { invalidate_caches(); return mVirusType; }
+    inline std::string& assay_ref() { invalidate_caches(); return mAssay; }
+    inline std::string& date_ref() { invalidate_caches(); return mDate; }
+    inline std::string& lab_ref() { invalidate_caches(); return mLab; }
+    inline std::string& rbc_ref() { invalidate_caches(); return mRbc; }
+    inline std::string& name_ref() { invalidate_caches(); return mName; }
+    inline std::string& subset_ref() { invalidate_caches(); return mSubset; }
+
+    inline auto& sources() { invalidate_caches(); return mSources; }
     inline const auto& sources() const { return mSources; }
 
+      // sorted indices of sources having the field (merged over sources of the source) equal to the argument
+    inline Indices sources_by_date(std::string aDate) const { return source_index().find(&SourceIndex::by_date, aDate); }
+    inline Indices sources_by_lab(std::string aLab) const { return source_index().find(&SourceIndex::by_lab, aLab); }
+    inline Indices sources_by_assay(std::string aAssay) const { return source_index().find(&SourceIndex::by_assay, aAssay); }
+      // sorted indices of sources with date in [aFirst, aAfterLast), empty bound means no limit
+    Indices sources_in_date_range(std::string aFirst, std::string aAfterLast) const;
+
+    inline void invalidate_caches() { mMerged.reset(); mSourceIndex.reset(); }
+
+      // "chart_info": own fields, "chart_info.sources": sources with their sources, merged fields and source index are not counted
+    void memory_usage(acmacs_chart_internal::MemoryUsage& aUsage) const;
+
  private:
     std::string mVirus;              // "v"
     std::string mVirusType;          // "V"
@@ -496,7 +702,38 @@ class ChartInfo : public ChartInfoBase
     TableType mType;                 // "T"
     std::vector<ChartInfo> mSources; // "S"
 
+    struct Merged
+    {
+        std::string virus, virus_type, assay, date, lab, rbc, name, subset, make_name;
+    };
+
+    struct SourceIndex
+    {
+        using Map = std::map<std::string, Indices>;
+        Map by_date, by_lab, by_assay;
+
+        inline Indices find(Map SourceIndex::* aMap, std::string aKey) const
+            {
+                const auto& map = this->*aMap;
+                if (const auto found = map.find(aKey); found != map.end())
+                    return found->second;
+                return {};
+            }
+    };
+
+    acmacs_chart_internal::Cache<Merged> mMerged;
+    acmacs_chart_internal::Cache<SourceIndex> mSourceIndex;
+
+    inline const Merged& merged() const { return mMerged.get(mSources.size(), [this]() { return make_merged(); }); }
+    Merged make_merged() const;
+    inline const SourceIndex& source_index() const { return mSourceIndex.get(mSources.size(), [this]() { return make_source_index(); }); }
+    SourceIndex make_source_index() const;
     std::string merge_text_fields(std::string ChartInfo::* aMember) const;
+    size_t fields_heap_bytes() const;
+    size_t heap_bytes() const;
+
+    friend class acmacs_chart_internal::BinaryWriter; // unmerged fields are serialized
+    friend class acmacs_chart_internal::BinaryReader;
 
 }; // class ChartInfo
 
@@ -576,9 +813,19 @@ class ChartTiters
     inline const Layers& layers() const { return mLayers; }
 
     inline size_t number_of_antigens() const { return !mList.empty() ? mList.size() : mDict.size(); }
+      // titers stored in the table and its layers, incl. "*" in the list form
+    size_t number_of_entries() const;
     Titer get(size_t ag_no, size_t sr_no) const;
     Titer max_for_serum(size_t sr_no) const;
 
+    enum TiterType : uint8_t { DontCare = 0, Regular = 1, LessThan = 2, MoreThan = 3 };
+    static constexpr const size_t NoLayer = static_cast<size_t>(-1);
+
+      // The table (aLayer == NoLayer) or one of its layers in numeric form, rows are converted in parallel.
+      // aValues, aTypes: aNumberOfAntigens x aNumberOfSera cells, row major.
+      // aValues: log2(titer/10), thresholded titers without threshold sign, NaN for dont-care.
+    void numeric(size_t aNumberOfAntigens, size_t aNumberOfSera, double* aValues, TiterType* aTypes, size_t aLayer = NoLayer) const;
+
  private:
     List mList;                 // "l"
     Dict mDict;                 // "d"
@@ -599,33 +846,33 @@ class Chart : public ChartBase
 
     // inline std::string virus_type() const { return mInfo.virus_type(); }
 
-    inline size_t number_of_antigens() const override { return mAntigens.size(); }
-    inline size_t number_of_sera() const override { return mSera.size(); }
+    inline size_t number_of_antigens() const override { return mAntigens->size(); }
+    inline size_t number_of_sera() const override { return mSera->size(); }
     inline size_t number_of_points() const { return number_of_antigens() + number_of_sera(); }
     std::string lineage() const;
     const std::string make_name(size_t aProjectionNo = static_cast<size_t>(-1)) const;
 
-    inline const ChartInfoBase& chart_info() const override { return mInfo; }
-    inline const ChartInfo& chart_info_for_json() const { return mInfo; }
-    inline ChartInfo& chart_info() { return mInfo; }
+    inline const ChartInfoBase& chart_info() const override { return *mInfo; }
+    inline const ChartInfo& chart_info_for_json() const { return *mInfo; }
+    inline ChartInfo& chart_info() { return mInfo.modify(); }
 
-    inline const Antigens& antigens() const { return mAntigens; }
-    inline Antigens& antigens() { return mAntigens; }
-    inline const AntigenBase& antigen(size_t ag_no) const override { return mAntigens[ag_no]; }
+    inline const Antigens& antigens() const { return *mAntigens; }
+    inline Antigens& antigens() { return mAntigens.modify(); }
+    inline const AntigenBase& antigen(size_t ag_no) const override { return (*mAntigens)[ag_no]; }
     // inline Antigen& antigen(size_t ag_no) { return mAntigens[ag_no]; }
 
-    inline const Sera& sera() const { return mSera; }
-    inline Sera& sera() { return mSera; }
-    inline const SerumBase& serum(size_t sr_no) const override { return mSera[sr_no]; }
+    inline const Sera& sera() const { return *mSera; }
+    inline Sera& sera() { return mSera.modify(); }
+    inline const SerumBase& serum(size_t sr_no) const override { return (*mSera)[sr_no]; }
     // inline Serum& serum(size_t sr_no) { return mSera[sr_no]; }
 
-    inline const ChartTiters& titers() const { return mTiters; }
-    inline ChartTiters& titers() { return mTiters; }
+    inline const ChartTiters& titers() const { return *mTiters; }
+    inline ChartTiters& titers() { return mTiters.modify(); }
 
-    inline const auto& column_bases() const { return mColumnBases; }
-    inline auto& column_bases() { return mColumnBases; }
-    inline std::vector<double>& column_bases_for_json() { return mColumnBases.data(); }
-    inline const std::vector<double>& column_bases_for_json() const { return mColumnBases.data(); }
+    inline const ColumnBases& column_bases() const { return *mColumnBases; }
+    inline ColumnBases& column_bases() { return mColumnBases.modify(); }
+    inline std::vector<double>& column_bases_for_json() { return mColumnBases.modify().data(); }
+    inline const std::vector<double>& column_bases_for_json() const { return mColumnBases->data(); }
     double compute_column_basis(const MinimumColumnBasisBase& aMinimumColumnBasis, size_t aSerumNo) const;
     inline void compute_column_bases(const MinimumColumnBasisBase& aMinimumColumnBasis, ColumnBases& aColumnBases) const
         {
@@ -635,22 +882,22 @@ class Chart : public ChartBase
         }
     inline void column_bases(const MinimumColumnBasisBase& aMinimumColumnBasis, ColumnBases& aColumnBases) const
         {
-            if (mColumnBases.empty()) {
+            if (mColumnBases->empty()) {
                 compute_column_bases(aMinimumColumnBasis, aColumnBases);
             }
             else {
-                aColumnBases = mColumnBases;
+                aColumnBases = *mColumnBases;
                 // aColumnBases.resize(mColumnBases.size());
                 // std::copy(mColumnBases.begin(), mColumnBases.end(), aColumnBases.begin());
             }
         }
     inline double column_basis(const MinimumColumnBasisBase& aMinimumColumnBasis, size_t aSerumNo) const
         {
-            if (mColumnBases.empty()) {
+            if (mColumnBases->empty()) {
                 return compute_column_basis(aMinimumColumnBasis, aSerumNo);
             }
             else {
-                return mColumnBases.at(aSerumNo);
+                return mColumnBases->at(aSerumNo);
             }
         }
     inline void column_bases(size_t aProjectionNo, ColumnBases& aColumnBases) const
@@ -660,7 +907,7 @@ class Chart : public ChartBase
                 column_bases(p.minimum_column_basis(), aColumnBases);
             }
             else {
-                aColumnBases = mColumnBases;
+                aColumnBases = *mColumnBases;
                 // aColumnBases.resize(p.column_bases().size());
                 // std::copy(p.column_bases().begin(), p.column_bases().end(), aColumnBases.begin());
             }
@@ -678,14 +925,15 @@ class Chart : public ChartBase
             return result;
         }
 
-    inline std::vector<Projection>& projections() { return mProjections; }
-    inline const std::vector<Projection>& projections() const { return mProjections; }
-    inline ProjectionBase& projection(size_t aProjectionNo) { return mProjections[aProjectionNo]; }
-    inline const ProjectionBase& projection(size_t aProjectionNo) const override { return mProjections[aProjectionNo]; }
-    inline size_t number_of_projections() const override { return mProjections.size(); }
+      // projections share their layouts and multipliers with the projections of the source of the copy
+    inline std::vector<Projection>& projections() { return mProjections.modify(); }
+    inline const std::vector<Projection>& projections() const { return *mProjections; }
+    inline ProjectionBase& projection(size_t aProjectionNo) { return mProjections.modify()[aProjectionNo]; }
+    inline const ProjectionBase& projection(size_t aProjectionNo) const override { return (*mProjections)[aProjectionNo]; }
+    inline size_t number_of_projections() const override { return mProjections->size(); }
 
-    inline const ChartPlotSpec& plot_spec() const { return mPlotSpec; }
-    inline ChartPlotSpec& plot_spec() { return mPlotSpec; }
+    inline const ChartPlotSpec& plot_spec() const { return *mPlotSpec; }
+    inline ChartPlotSpec& plot_spec() { return mPlotSpec.modify(); }
 
     // inline acmacs::IndexGenerator antigen_indices() const { return {number_of_antigens(), [](size_t) { return true; } }; }
     // inline acmacs::IndexGenerator reference_antigen_indices() const { return {number_of_antigens(), [this](size_t index) { return mAntigens[index].reference(); } }; }
@@ -696,12 +944,21 @@ class Chart : public ChartBase
 
     inline acmacs::IndexGenerator antigens_not_found_in(const Chart& aNother) const
         {
+              // index is looked up on each call: aNother may be modified (and its cached index rebuilt) while the generator is alive
             auto filter = [this,&aNother](size_t aIndex) -> bool {
-                return !aNother.antigens().find_by_full_name(this->antigens()[aIndex].full_name());
+                const auto& another_index = aNother.antigens().full_name_index();
+                return another_index.find(this->antigens()[aIndex].full_name()) == another_index.end();
             };
             return {number_of_antigens(), filter};
         }
 
+    inline FullNameMatch match_antigens(const Chart& aNother) const { return mAntigens->match_full_names(aNother.antigens()); }
+    inline FullNameMatch match_sera(const Chart& aNother) const { return mSera->match_full_names(aNother.sera()); }
+    std::vector<FullNameMatch> match_antigens(const std::vector<const Chart*>& aOthers) const;
+    std::vector<FullNameMatch> match_sera(const std::vector<const Chart*>& aOthers) const;
+
+      // annotation sets of antigens and sera are interned in one table, called after import
+    void intern_annotations();
     void find_homologous_antigen_for_sera();
     inline void find_homologous_antigen_for_sera_const() const { const_cast<Chart*>(this)->find_homologous_antigen_for_sera(); }
 
@@ -711,16 +968,24 @@ class Chart : public ChartBase
       // aOutside4Fold: indices of antigens with titers against aSerumNo outside 4fold distance from homologous titer
     void serum_coverage(size_t aAntigenNo, size_t aSerumNo, std::vector<size_t>& aWithin4Fold, std::vector<size_t>& aOutside4Fold) const;
 
+      // Bytes used by the chart by component ("antigens", "antigens.name", "titers.list", "projections[0].layout", ...) and "total".
+      // Heap memory of strings and capacities of vectors are counted. Components shared with copies of the chart
+      // are counted in each copy, cached indices are not counted. "string_pool" is the process-wide StringPool
+      // shared by all charts (semantic attributes, label texts, ...), it is not included in "total".
+    acmacs_chart_internal::MemoryUsage memory_usage() const;
+
     // inline bool operator < (const Chart& aNother) const { return table_id() < aNother.table_id(); }
 
  private:
-    ChartInfo mInfo;                       // "i"
-    Antigens mAntigens;                    // "a"
-    Sera mSera;                            // "s"
-    ChartTiters mTiters;                   // "t"
-    ColumnBases mColumnBases;              // "C"
-    std::vector<Projection> mProjections;  // "P"
-    ChartPlotSpec mPlotSpec;               // "p"
+      // components are shared between copies of the chart, non-const access copies the component if it is shared
+    acmacs_chart_internal::CopyOnWrite<ChartInfo> mInfo;                       // "i"
+    acmacs_chart_internal::CopyOnWrite<Antigens> mAntigens;                    // "a"
+    acmacs_chart_internal::CopyOnWrite<Sera> mSera;                            // "s"
+    acmacs_chart_internal::CopyOnWrite<ChartTiters> mTiters;                   // "t"
+    acmacs_chart_internal::CopyOnWrite<ColumnBases> mColumnBases;              // "C"
+    acmacs_chart_internal::CopyOnWrite<std::vector<Projection>> mProjections;  // "P"
+    acmacs_chart_internal::CopyOnWrite<ChartPlotSpec> mPlotSpec;               // "p"
+    AnnotationsTable mAnnotationsTable;
 
 }; // class Chart
 
@@ -0,0 +1,204 @@
+// Converts charts between formats, many files in parallel.
+// Usage: acmacs-chart-convert [--format ace|save|save.xz] [--output-dir <dir>] [--force] [--verbose] <input.ace|dir>...
+//        acmacs-chart-convert <input.ace> <output.ace|output.save|output.save.xz>
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <unistd.h>
+
+#include "chart.hh"
+#include "ace.hh"
+#include "lispmds.hh"
+#include "parallel.hh"
+
+namespace fs = std::filesystem;
+
+// ----------------------------------------------------------------------
+
+static const char* const sFormats[] = {".ace", ".save", ".save.xz"};
+
+static inline bool ends_with(const std::string& aSource, const std::string& aSuffix)
+{
+    return aSource.size() >= aSuffix.size() && aSource.compare(aSource.size() - aSuffix.size(), aSuffix.size(), aSuffix) == 0;
+}
+
+static inline std::string output_format(const std::string& aFilename)
+{
+      // ".save.xz" is checked before ".save"
+    for (auto format = std::rbegin(sFormats); format != std::rend(sFormats); ++format) {
+        if (ends_with(aFilename, *format))
+            return *format;
+    }
+    return {};
+}
+
+struct Conversion
+{
+    fs::path input;
+    fs::path output;
+};
+
+// ----------------------------------------------------------------------
+
+  // Files found in directories (recursively) are converted if their names end with .ace,
+  // outputs are placed under aOutputDir keeping the directory structure, or next to the inputs.
+static std::vector<Conversion> collect(const std::vector<std::string>& aInputs, std::string aFormat, const fs::path& aOutputDir)
+{
+    auto output_for = [&aFormat,&aOutputDir](const fs::path& aInput, const fs::path& aRelative) {
+        auto name = aRelative.filename().string();
+        if (ends_with(name, ".ace"))
+            name.resize(name.size() - 4);
+        const auto directory = aOutputDir.empty() ? aInput.parent_path() : aOutputDir / aRelative.parent_path();
+        return directory / (name + aFormat);
+    };
+
+    std::vector<Conversion> result;
+    for (const auto& input: aInputs) {
+        if (fs::is_directory(input)) {
+            for (const auto& entry: fs::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file() && ends_with(entry.path().filename().string(), ".ace"))
+                    result.push_back({entry.path(), output_for(entry.path(), fs::relative(entry.path(), input))});
+            }
+        }
+        else
+            result.push_back({input, output_for(input, fs::path(input).filename())});
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a.input < b.input; });
+    return result;
+
+} // collect
+
+// ----------------------------------------------------------------------
+
+  // Output overwriting its input (e.g. --format ace without --output-dir) would be reported up to date
+  // or replaced with a lossy re-export, two inputs with the same output would be written concurrently.
+static void check_outputs(const std::vector<Conversion>& aConversions)
+{
+    std::vector<std::pair<fs::path, const Conversion*>> outputs;
+    for (const auto& conversion: aConversions) {
+        const auto output = fs::weakly_canonical(conversion.output);
+        if (output == fs::weakly_canonical(conversion.input))
+            throw std::runtime_error("output is the same as input: " + conversion.input.string() + " (use --output-dir or another --format)");
+        outputs.emplace_back(output, &conversion);
+    }
+    std::sort(outputs.begin(), outputs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    if (const auto duplicate = std::adjacent_find(outputs.begin(), outputs.end(), [](const auto& a, const auto& b) { return a.first == b.first; }); duplicate != outputs.end())
+        throw std::runtime_error("the same output " + duplicate->first.string() + " for " + duplicate->second->input.string() + " and " + std::next(duplicate)->second->input.string());
+
+} // check_outputs
+
+// ----------------------------------------------------------------------
+
+static inline bool up_to_date(const Conversion& aConversion)
+{
+    std::error_code error;
+    const auto output_time = fs::last_write_time(aConversion.output, error);
+    return !error && output_time >= fs::last_write_time(aConversion.input);
+
+} // up_to_date
+
+  // Output is written to a temporary file in the same directory and renamed,
+  // so an interrupted run never leaves an incomplete file that looks up to date.
+static void convert(const Conversion& aConversion)
+{
+    std::unique_ptr<Chart> chart{import_chart(aConversion.input.string())};
+    if (const auto parent = aConversion.output.parent_path(); !parent.empty())
+        fs::create_directories(parent);
+    const auto temp = aConversion.output.parent_path() / (".tmp." + std::to_string(getpid()) + "." + aConversion.output.filename().string()); // keeps extension, it selects compression
+    try {
+        if (output_format(aConversion.output.string()) == ".ace")
+            export_chart(temp.string(), *chart);
+        else
+            export_chart_lispmds(temp.string(), *chart);
+        fs::rename(temp, aConversion.output);
+    }
+    catch (...) {
+        std::error_code error;
+        fs::remove(temp, error);
+        throw;
+    }
+
+} // convert
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    std::string format;
+    fs::path output_dir;
+    bool force = false, verbose = false;
+    std::vector<std::string> inputs;
+    for (int arg = 1; arg < argc; ++arg) {
+        const std::string option = argv[arg];
+        if (arg + 1 < argc && (option == "--format" || option == "-f"))
+            format = std::string{"."} + argv[++arg];
+        else if (arg + 1 < argc && (option == "--output-dir" || option == "-o"))
+            output_dir = argv[++arg];
+        else if (option == "--force")
+            force = true;
+        else if (option == "--verbose" || option == "-v")
+            verbose = true;
+        else if (!option.empty() && option[0] != '-')
+            inputs.push_back(option);
+        else {
+            inputs.clear();
+            break;
+        }
+    }
+
+    std::vector<Conversion> conversions;
+    try {
+        if (format.empty() && output_dir.empty() && inputs.size() == 2 && !output_format(inputs[1]).empty() && !fs::is_directory(inputs[1])) {
+            conversions.push_back({inputs[0], inputs[1]}); // acmacs-chart-convert <input> <output>
+            force = true;
+        }
+        else if (!inputs.empty() && std::find(std::begin(sFormats), std::end(sFormats), format) != std::end(sFormats))
+            conversions = collect(inputs, format, output_dir);
+        check_outputs(conversions);
+    }
+    catch (std::exception& err) {
+        std::cerr << "ERROR: " << err.what() << '\n';
+        return 1;
+    }
+    if (conversions.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--format ace|save|save.xz] [--output-dir <dir>] [--force] [--verbose] <input.ace|dir>...\n"
+                  << "       " << argv[0] << " <input.ace> <output.ace|output.save|output.save.xz>\n"
+                  << "  directories are scanned recursively for *.ace, up to date outputs are skipped unless --force is given\n";
+        return 1;
+    }
+
+    std::atomic<size_t> converted{0}, skipped{0}, failed{0};
+    std::mutex report_access;
+    acmacs_chart_internal::parallel_for(conversions.size(), [&](size_t conversion_no) {
+        const auto& conversion = conversions[conversion_no];
+        try {
+            if (!force && up_to_date(conversion)) {
+                ++skipped;
+                return;
+            }
+            convert(conversion);
+            ++converted;
+            if (verbose) {
+                std::lock_guard<std::mutex> lock{report_access};
+                std::cerr << conversion.input.string() << " -> " << conversion.output.string() << '\n';
+            }
+        }
+        catch (std::exception& err) {
+            ++failed;
+            std::lock_guard<std::mutex> lock{report_access};
+            std::cerr << "ERROR: " << conversion.input.string() << ": " << err.what() << '\n';
+        }
+    });
+
+    std::cerr << "converted: " << converted << "  up to date: " << skipped << "  failed: " << failed << '\n';
+    return failed ? 1 : 0;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+
+#include "acmacs-chart-1/trace.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Value shared by copies of the owner through a reference counted block.
+      // Const access never copies, modify() copies the block if it is shared with another owner.
+      // Different owners sharing the block can be used from different threads,
+      // the same owner must not be modified and accessed concurrently (as with plain members).
+    template <typename T> class CopyOnWrite
+    {
+     public:
+        inline CopyOnWrite() : mData(std::make_shared<T>()) {}
+        inline CopyOnWrite(const CopyOnWrite&) = default;
+        inline CopyOnWrite& operator=(const CopyOnWrite&) = default;
+
+        inline const T& operator*() const { return *mData; }
+        inline const T* operator->() const { return mData.get(); }
+
+        inline T& modify()
+            {
+                if (mData.use_count() > 1) {
+                    count(Counter::ComponentCopies);
+                    mData = std::make_shared<T>(*mData);
+                }
+                else
+                    std::atomic_thread_fence(std::memory_order_acquire); // reads by the former co-owners happen before our writes
+                return *mData;
+            }
+
+        inline bool shared() const { return mData.use_count() > 1; }
+        inline bool shares_with(const CopyOnWrite& aNother) const { return mData == aNother.mData; }
+
+     private:
+        std::shared_ptr<T> mData;
+
+    }; // class CopyOnWrite<T>
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
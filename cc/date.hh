@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Date "YYYY", "YYYY-MM" or "YYYY-MM-DD" as integer YYYYMMDD (missing parts are 0).
+      // Valid codes compare exactly as the date strings do, so partial dates used as
+      // range bounds (e.g. "2016") keep their meaning.
+    using DateCode = int32_t;
+    constexpr const DateCode DateMissing = 0;
+    constexpr const DateCode DateInvalid = -1;
+
+    inline DateCode date_code(const char* str, size_t length)
+    {
+        if (length == 0)
+            return DateMissing;
+        auto number = [str](size_t aStart, size_t aLength) -> int {
+            int result = 0;
+            for (size_t pos = aStart; pos < aStart + aLength; ++pos) {
+                if (str[pos] < '0' || str[pos] > '9')
+                    return -1;
+                result = result * 10 + (str[pos] - '0');
+            }
+            return result;
+        };
+        if (length != 4 && length != 7 && length != 10)
+            return DateInvalid;
+        const int year = number(0, 4);
+        const int month = length > 4 && str[4] == '-' ? number(5, 2) : (length > 4 ? -1 : 0);
+        const int day = length > 7 && str[7] == '-' ? number(8, 2) : (length > 7 ? -1 : 0);
+        if (year < 0 || month < 0 || month > 12 || day < 0 || day > 31 || (length > 4 && month == 0) || (length > 7 && day == 0))
+            return DateInvalid;
+        return year * 10000 + month * 100 + day;
+    }
+
+    inline DateCode date_code(const std::string& aDate) { return date_code(aDate.data(), aDate.size()); }
+
+// ----------------------------------------------------------------------
+
+      // Permutation of antigens sorted by date, answers range queries with binary search.
+    class DateIndex
+    {
+     public:
+        using Indices = std::vector<size_t>;
+
+          // aDateCodes: date code of each antigen
+        inline DateIndex(const std::vector<DateCode>& aDateCodes)
+            {
+                for (size_t no = 0; no < aDateCodes.size(); ++no) {
+                    if (aDateCodes[no] > DateMissing)
+                        mOrder.push_back(no);
+                    else if (aDateCodes[no] == DateInvalid)
+                        mInvalid.push_back(no);
+                }
+                std::stable_sort(mOrder.begin(), mOrder.end(), [&aDateCodes](size_t a, size_t b) { return aDateCodes[a] < aDateCodes[b]; });
+                mCodes.resize(mOrder.size());
+                std::transform(mOrder.begin(), mOrder.end(), mCodes.begin(), [&aDateCodes](size_t no) { return aDateCodes[no]; });
+            }
+
+          // unsorted indices of antigens having valid date in [aFirst, aAfterLast), DateMissing means no bound
+        inline Indices range(DateCode aFirst, DateCode aAfterLast) const
+            {
+                const auto first = aFirst == DateMissing ? mCodes.begin() : std::lower_bound(mCodes.begin(), mCodes.end(), aFirst);
+                const auto last = aAfterLast == DateMissing ? mCodes.end() : std::lower_bound(first, mCodes.end(), aAfterLast);
+                return Indices(mOrder.begin() + (first - mCodes.begin()), mOrder.begin() + (last - mCodes.begin()));
+            }
+
+        inline const Indices& invalid() const { return mInvalid; } // antigens with dates that cannot be parsed
+
+     private:
+        std::vector<DateCode> mCodes;   // sorted
+        Indices mOrder;                 // antigen index for each element of mCodes
+        Indices mInvalid;
+
+    }; // class DateIndex
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
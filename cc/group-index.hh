@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+
+#include "acmacs-chart-1/bitset.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Antigens (sera) of a chart partitioned into named groups, each group is a bitset.
+    class GroupIndex
+    {
+     public:
+        using Indices = Bitset::Indices;
+        enum class Group : size_t { Continent, Country, Clade, Lineage, PassageType, Attribute, Size_ };
+          // names in Group::Attribute
+        static constexpr const char* Reference = "reference";
+        static constexpr const char* Test = "test";
+        static constexpr const char* Egg = "egg";
+        static constexpr const char* Cell = "cell";
+        static constexpr const char* Reassortant = "reassortant";
+
+        inline GroupIndex(size_t aSize) : mSize{aSize} {}
+
+        inline size_t size() const { return mSize; }
+
+        inline void add(Group aGroup, std::string aName, size_t aIndex)
+            {
+                group(aGroup).emplace(aName, Bitset(mSize)).first->second.set(aIndex);
+            }
+
+          // empty set if there is no such group
+        inline Bitset get(Group aGroup, std::string aName) const
+            {
+                if (const auto* found = find(aGroup, aName); found)
+                    return *found;
+                return Bitset(mSize);
+            }
+
+        inline const Bitset* find(Group aGroup, std::string aName) const
+            {
+                const auto& grp = group(aGroup);
+                if (const auto found = grp.find(aName); found != grp.end())
+                    return &found->second;
+                return nullptr;
+            }
+
+          // removes from aIndices entries not in the group
+        inline void filter(Indices& aIndices, Group aGroup, std::string aName) const
+            {
+                if (const auto* found = find(aGroup, aName); found)
+                    found->filter(aIndices);
+                else
+                    aIndices.clear();
+            }
+
+        inline std::vector<std::string> names(Group aGroup) const
+            {
+                std::vector<std::string> result;
+                for (const auto& entry: group(aGroup))
+                    result.push_back(entry.first);
+                return result;
+            }
+
+     private:
+        size_t mSize;
+        std::array<std::map<std::string, Bitset>, static_cast<size_t>(Group::Size_)> mGroups;
+
+        inline std::map<std::string, Bitset>& group(Group aGroup) { return mGroups[static_cast<size_t>(aGroup)]; }
+        inline const std::map<std::string, Bitset>& group(Group aGroup) const { return mGroups[static_cast<size_t>(aGroup)]; }
+
+    }; // class GroupIndex
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
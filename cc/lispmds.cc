@@ -6,18 +6,20 @@
 
 #include "lispmds.hh"
 #include "chart.hh"
+#include "chart-view.hh"
 #include "point-style.hh"
+#include "trace.hh"
 
 // ----------------------------------------------------------------------
 
-static std::string make_lispmds(const Chart& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation* aTransformation);
-static std::string table(const Chart& aChart);
-static std::string reference_antigens(const Chart& aChart);
-static std::string projections(const Chart& aChart);
-static std::string layout(const Projection& aProjection, const Chart& aChart);
-static std::string plot_spec(const Chart& aChart, const std::vector<PointStyle>& aPointStyles);
-static std::string transformation(const Chart& aChart, const acmacs::Transformation* aTransformation);
-static std::string acmacs_b1_data(const Chart& aChart);
+template <typename C> static std::string make_lispmds(const C& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation* aTransformation);
+template <typename C> static std::string table(const C& aChart);
+template <typename C> static std::string reference_antigens(const C& aChart);
+template <typename C> static std::string projections(const C& aChart);
+template <typename P, typename C> static std::string layout(const P& aProjection, const C& aChart);
+template <typename C> static std::string plot_spec(const C& aChart, const std::vector<PointStyle>& aPointStyles);
+template <typename C> static std::string transformation(const C& aChart, const acmacs::Transformation* aTransformation);
+template <typename C> static std::string acmacs_b1_data(const C& aChart);
 static std::string encode(std::string aSource);
 static std::string convert_titer(std::string aSource);
 static std::string double_to_string_lisp(double aValue);
@@ -41,8 +43,26 @@ void export_chart_lispmds(std::string aFilename, const Chart& aChart, const std:
 
 // ----------------------------------------------------------------------
 
-std::string make_lispmds(const Chart& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation* aTransformation)
+void export_chart_lispmds(std::string aFilename, const ChartView& aChart)
 {
+    std::vector<PointStyle> point_styles;
+    acmacs::file::write(aFilename, make_lispmds(aChart, point_styles, nullptr));
+
+} // export_chart_lispmds
+
+// ----------------------------------------------------------------------
+
+void export_chart_lispmds(std::string aFilename, const ChartView& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation& aTransformation)
+{
+    acmacs::file::write(aFilename, make_lispmds(aChart, aPointStyles, &aTransformation));
+
+} // export_chart_lispmds
+
+// ----------------------------------------------------------------------
+
+template <typename C> std::string make_lispmds(const C& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation* aTransformation)
+{
+    acmacs_chart_internal::TraceTimer trace_timer{"make_lispmds"};
     std::string output = ";; MDS configuration file (version 0.5). -*- Lisp -*-\n;; Created by acmacsd/acmacs-chart at ";
     output += acmacs::time_format("%Y-%m-%d %H:%M %Z\n");
     output += ";; Table: " + aChart.make_name() + "\n";
@@ -70,7 +90,7 @@ std::string make_lispmds(const Chart& aChart, const std::vector<PointStyle>& aPo
 
 // ----------------------------------------------------------------------
 
-std::string table(const Chart& aChart)
+template <typename C> std::string table(const C& aChart)
 {
     const auto& antigens = aChart.antigens();
     const auto& sera = aChart.sera();
@@ -104,7 +124,7 @@ std::string table(const Chart& aChart)
 
 // ----------------------------------------------------------------------
 
-std::string reference_antigens(const Chart& aChart)
+template <typename C> std::string reference_antigens(const C& aChart)
 {
     std::string output;
     const auto& antigens = aChart.antigens();
@@ -121,7 +141,7 @@ std::string reference_antigens(const Chart& aChart)
 
 // ----------------------------------------------------------------------
 
-std::string projections(const Chart& aChart)
+template <typename C> std::string projections(const C& aChart)
 {
     std::string output;
     const auto& projections = aChart.projections();
@@ -147,7 +167,7 @@ std::string projections(const Chart& aChart)
 
 // ----------------------------------------------------------------------
 
-std::string layout(const Projection& aProjection, const Chart& aChart)
+template <typename P, typename C> std::string layout(const P& aProjection, const C& aChart)
 {
     std::string output;
     const auto& layout = aProjection.layout();
@@ -197,7 +217,7 @@ std::string layout(const Projection& aProjection, const Chart& aChart)
 
 // ----------------------------------------------------------------------
 
-std::string plot_spec(const Chart& aChart, const std::vector<PointStyle>& aPointStyles)
+template <typename C> std::string plot_spec(const C& aChart, const std::vector<PointStyle>& aPointStyles)
 {
     std::string output;
     if (!aPointStyles.empty()) {
@@ -232,7 +252,7 @@ std::string plot_spec(const Chart& aChart, const std::vector<PointStyle>& aPoint
 
 // ----------------------------------------------------------------------
 
-std::string transformation(const Chart& aChart, const acmacs::Transformation* aTransformation)
+template <typename C> std::string transformation(const C& aChart, const acmacs::Transformation* aTransformation)
 {
     std::string output;
     output += R"(    :CANVAS-COORD-TRANSFORMATIONS '(
@@ -262,7 +282,7 @@ std::string transformation(const Chart& aChart, const acmacs::Transformation* aT
 
 // ----------------------------------------------------------------------
 
-std::string acmacs_b1_data(const Chart& aChart)
+template <typename C> std::string acmacs_b1_data(const C& aChart)
 {
     std::string output = "    :ACMACS-B1-ANTIGENS '(\n";
     const auto& antigens = aChart.antigens();
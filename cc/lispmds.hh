@@ -6,12 +6,17 @@
 // ----------------------------------------------------------------------
 
 class Chart;
+class ChartView;
 class PointStyle;
 namespace acmacs { class Transformation; }
 
 void export_chart_lispmds(std::string aFilename, const Chart& aChart);
 void export_chart_lispmds(std::string aFilename, const Chart& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation& aTransformation);
 
+  // exported straight from the view, aPointStyles are for the points of the view
+void export_chart_lispmds(std::string aFilename, const ChartView& aChart);
+void export_chart_lispmds(std::string aFilename, const ChartView& aChart, const std::vector<PointStyle>& aPointStyles, const acmacs::Transformation& aTransformation);
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
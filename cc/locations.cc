@@ -0,0 +1,114 @@
+#include <mutex>
+#include <unordered_map>
+
+#include "acmacs-base/virus-name.hh"
+#include "locationdb/locdb.hh"
+
+#include "locations.hh"
+#include "parallel.hh"
+#include "trace.hh"
+
+// ----------------------------------------------------------------------
+
+const LocDb& acmacs_chart_internal::locdb()
+{
+    static const LocDb& locdb = get_locdb(); // initialization of function statics is thread safe
+    return locdb;
+
+} // acmacs_chart_internal::locdb
+
+// ----------------------------------------------------------------------
+
+namespace
+{
+    class LocationCache
+    {
+     public:
+        std::mutex access;
+        std::unordered_map<std::string, acmacs_chart_internal::LocationData> data; // node based: references to values are stable
+    };
+}
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#pragma GCC diagnostic ignored "-Wglobal-constructors"
+#endif
+
+static LocationCache sLocationCache;
+
+#pragma GCC diagnostic pop
+
+const acmacs_chart_internal::LocationData& acmacs_chart_internal::find_location(std::string aLocation)
+{
+    std::lock_guard<std::mutex> lock{sLocationCache.access};
+    const auto [pos, inserted] = sLocationCache.data.emplace(aLocation, LocationData{});
+    if (inserted) {
+        const auto& db = locdb();
+        auto resolve = [&aLocation](std::string& aTarget, auto aLookup) {
+            count(Counter::LocDbLookups);
+            try {
+                aTarget = aLookup(aLocation);
+            }
+            catch (std::exception&) {   // LocationNotFound
+            }
+        };
+        resolve(pos->second.country, [&db](const auto& loc) { return db.country(loc); });
+        resolve(pos->second.continent, [&db](const auto& loc) { return db.continent(loc); });
+        resolve(pos->second.abbreviation, [&db](const auto& loc) { return db.abbreviation(loc); });
+    }
+    return pos->second;
+
+} // acmacs_chart_internal::find_location
+
+// ----------------------------------------------------------------------
+
+acmacs_chart_internal::Locations::Locations(const std::vector<std::string>& aNames)
+    : mEntries(aNames.size())
+{
+    TraceTimer trace_timer{"Locations"};
+    for (auto* table: {&mLocations, &mCountries, &mContinents, &mAbbreviations})
+        table->insert("UNKNOWN");   // id 0 == Unknown
+
+      // parse names
+    std::vector<std::string> location_of(aNames.size());
+    parallel_for(aNames.size(), [&aNames,&location_of](size_t entry_no) {
+        try {
+            location_of[entry_no] = virus_name::location(aNames[entry_no]);
+        }
+        catch (std::exception&) {
+        }
+    }, 64);
+    for (size_t entry_no = 0; entry_no < aNames.size(); ++entry_no) {
+        if (!location_of[entry_no].empty())
+            mEntries[entry_no].location = mLocations.insert(location_of[entry_no]);
+    }
+
+      // each distinct location, lookups are serialized by find_location()
+    std::vector<const LocationData*> resolved(mLocations.size(), nullptr);
+    for (size_t location_id = 1; location_id < resolved.size(); ++location_id)
+        resolved[location_id] = &find_location(mLocations[static_cast<Id>(location_id)]);
+
+    std::vector<Entry> by_location(mLocations.size());
+    for (size_t location_id = 1; location_id < resolved.size(); ++location_id) {
+        const auto& source = *resolved[location_id];
+        auto& target = by_location[location_id];
+        if (!source.country.empty())
+            target.country = mCountries.insert(source.country);
+        if (!source.continent.empty())
+            target.continent = mContinents.insert(source.continent);
+        if (!source.abbreviation.empty())
+            target.abbreviation = mAbbreviations.insert(source.abbreviation);
+    }
+    for (auto& entry: mEntries) {
+        const auto location = entry.location;
+        entry = by_location[location];
+        entry.location = location;
+    }
+
+} // acmacs_chart_internal::Locations::Locations
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "acmacs-chart-1/string-table.hh"
+
+class LocDb;
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // get_locdb() loads the database on the first call and must not race with itself,
+      // the first call is made once here.
+    const LocDb& locdb();
+
+      // Country, continent and abbreviation of a location, empty if location is not in locdb.
+      // LocDb makes no promise about concurrent lookups, they are serialized here and
+      // memoized: each distinct location is looked up once per process, never throws.
+    class LocationData
+    {
+     public:
+        std::string country;
+        std::string continent;
+        std::string abbreviation;
+    };
+
+    const LocationData& find_location(std::string aLocation);
+
+      // Location, country, continent and location abbreviation of each antigen/serum,
+      // parsed from the name and looked up in locdb once, interned as small integer ids.
+    class Locations
+    {
+     public:
+        using Id = StringTable::Id;
+        static constexpr const Id Unknown = 0; // name cannot be parsed or location is not in locdb, string for this id is "UNKNOWN"
+
+        class Entry
+        {
+         public:
+            Id location = Unknown;
+            Id country = Unknown;
+            Id continent = Unknown;
+            Id abbreviation = Unknown;
+        };
+
+          // aNames: name for each antigen/serum, names are parsed and locations looked up in parallel
+        Locations(const std::vector<std::string>& aNames);
+
+        inline size_t size() const { return mEntries.size(); }
+        inline const Entry& operator[](size_t aEntryNo) const { return mEntries[aEntryNo]; }
+
+        inline const StringTable& locations() const { return mLocations; }
+        inline const StringTable& countries() const { return mCountries; }
+        inline const StringTable& continents() const { return mContinents; }
+        inline const StringTable& abbreviations() const { return mAbbreviations; }
+
+        inline const std::string& location(size_t aEntryNo) const { return mLocations[mEntries[aEntryNo].location]; }
+        inline const std::string& country(size_t aEntryNo) const { return mCountries[mEntries[aEntryNo].country]; }
+        inline const std::string& continent(size_t aEntryNo) const { return mContinents[mEntries[aEntryNo].continent]; }
+        inline const std::string& abbreviation(size_t aEntryNo) const { return mAbbreviations[mEntries[aEntryNo].abbreviation]; }
+
+     private:
+        StringTable mLocations;
+        StringTable mCountries;
+        StringTable mContinents;
+        StringTable mAbbreviations;
+        std::vector<Entry> mEntries;
+
+    }; // class Locations
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
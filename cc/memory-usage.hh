@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <type_traits>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // bytes by component, e.g. {"antigens.name": 123456}
+    using MemoryUsage = std::map<std::string, size_t>;
+
+      // Heap memory owned by a value, sizeof of the value itself is counted by its owner
+      // (e.g. in the capacity of the vector the value is stored in).
+    inline size_t heap_bytes(const std::string& aValue)
+    {
+        static const size_t sso_capacity = std::string{}.capacity(); // short strings are stored inside std::string
+        return aValue.capacity() > sso_capacity ? aValue.capacity() + 1 : 0;
+    }
+
+    template <typename T1, typename T2> inline size_t heap_bytes(const std::pair<T1, T2>& aValue);
+
+    template <typename T> inline size_t heap_bytes(const std::vector<T>& aValue)
+    {
+        size_t result = aValue.capacity() * sizeof(T);
+        if constexpr (!std::is_arithmetic_v<T>) {
+            for (const auto& element: aValue)
+                result += heap_bytes(element);
+        }
+        return result;
+    }
+
+    template <typename T1, typename T2> inline size_t heap_bytes(const std::pair<T1, T2>& aValue)
+    {
+        return heap_bytes(aValue.first) + heap_bytes(aValue.second);
+    }
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
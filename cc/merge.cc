@@ -0,0 +1,334 @@
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <charconv>
+
+#include "merge.hh"
+#include "chart.hh"
+#include "ace.hh"
+#include "parallel.hh"
+#include "trace.hh"
+
+// ----------------------------------------------------------------------
+
+using Mapping = std::vector<size_t>; // source index -> merged index
+
+static inline bool is_dont_care(const std::string& aTiter) { return aTiter.empty() || aTiter.front() == '*'; }
+
+  // calls aFunc(ag_no, sr_no, titer) for each titer in aSource which is not dont-care
+template <typename Func> static inline void for_each_titer(const ChartTiters::Dict& aSource, Func aFunc)
+{
+    for (size_t ag_no = 0; ag_no < aSource.size(); ++ag_no) {
+        for (const auto& [sr_no, titer]: aSource[ag_no]) {
+            if (!is_dont_care(titer))
+                aFunc(ag_no, std::stoul(sr_no), titer);
+        }
+    }
+}
+
+template <typename Func> static inline void for_each_titer(const ChartTiters::List& aSource, Func aFunc)
+{
+    for (size_t ag_no = 0; ag_no < aSource.size(); ++ag_no) {
+        for (size_t sr_no = 0; sr_no < aSource[ag_no].size(); ++sr_no) {
+            if (!is_dont_care(aSource[ag_no][sr_no]))
+                aFunc(ag_no, sr_no, aSource[ag_no][sr_no]);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------
+
+static inline std::string merge_key(const Antigen& aAntigen, MergeMatch aMatch)
+{
+    switch (aMatch) {
+      case MergeMatch::Strict:
+          break;
+      case MergeMatch::IgnorePassageDate:
+          return string::join({aAntigen.name(), aAntigen.reassortant(), aAntigen.annotations().join(), aAntigen.passage_without_date()});
+      case MergeMatch::IgnorePassage:
+          return aAntigen.full_name_without_passage();
+    }
+    return aAntigen.full_name();
+
+} // merge_key
+
+static inline std::string merge_key(const Serum& aSerum, MergeMatch)
+{
+    return aSerum.full_name();
+
+} // merge_key
+
+// ----------------------------------------------------------------------
+
+  // Sources are added in batches, merge_chart_files releases each batch before importing the next one.
+class Merger
+{
+ public:
+    inline Merger(MergeMatch aMatch) : mMatch(aMatch), mMerged(std::make_unique<Chart>()) {}
+
+    void add(const std::vector<const Chart*>& aCharts);
+      // merged titers from all layers
+    Chart* finish();
+
+ private:
+    MergeMatch mMatch;
+    std::unique_ptr<Chart> mMerged;
+    size_t mNumberOfSources = 0;
+    std::string mVirus, mVirusType, mAssay, mLineage; // of the first source where known
+    std::unordered_map<std::string, size_t> mAntigenIndex, mSerumIndex; // merge key -> merged index
+
+    void check_compatible(const Chart& aChart);
+    template <typename AgSr> Mapping add_entries(AgSr& aTarget, const AgSr& aSource, std::unordered_map<std::string, size_t>& aIndex) const;
+    void add_lab_ids(const Antigens& aSource, const Mapping& aMapping);
+    void add_homologous(const Sera& aSource, size_t aFirstNewSerum, const Mapping& aSerumMapping, const Mapping& aAntigenMapping);
+    static void make_layer(ChartTiters::Dict& aLayer, const ChartTiters& aSource, size_t aSourceLayerNo, const Mapping& aAntigenMapping, const Mapping& aSerumMapping);
+
+}; // class Merger
+
+// ----------------------------------------------------------------------
+
+  // empty (unknown) values are compatible with anything, lineages are compared for single lineage sources only
+void Merger::check_compatible(const Chart& aChart)
+{
+    auto check = [source_no=mNumberOfSources](const char* aField, std::string& aMerged, std::string aSource) {
+        if (aMerged.empty())
+            aMerged = aSource;
+        else if (!aSource.empty() && aSource != aMerged)
+            throw MergeError{std::string{"cannot merge source "} + std::to_string(source_no) + ": " + aField + " \"" + aSource + "\" differs from \"" + aMerged + "\""};
+    };
+
+    const auto& info = aChart.chart_info();
+    check("virus", mVirus, info.virus());
+    check("virus type", mVirusType, info.virus_type());
+    check("assay", mAssay, info.assay());
+    if (const auto lineage = aChart.lineage(); lineage.find('+') == std::string::npos)
+        check("lineage", mLineage, lineage);
+
+} // Merger::check_compatible
+
+// ----------------------------------------------------------------------
+
+  // the first occurrence of an entry defines merged entry, returns index in aTarget for each entry of aSource
+template <typename AgSr> Mapping Merger::add_entries(AgSr& aTarget, const AgSr& aSource, std::unordered_map<std::string, size_t>& aIndex) const
+{
+    std::vector<std::string> keys(aSource.size());
+    acmacs_chart_internal::parallel_for(aSource.size(), [&](size_t no) { keys[no] = merge_key(aSource[no], mMatch); }, 256);
+    Mapping mapping(aSource.size());
+    for (size_t no = 0; no < aSource.size(); ++no) {
+        const auto [pos, inserted] = aIndex.emplace(std::move(keys[no]), aTarget.size());
+        if (inserted)
+            aTarget.push_back(aSource[no]);
+        mapping[no] = pos->second;
+    }
+    return mapping;
+
+} // Merger::add_entries
+
+// ----------------------------------------------------------------------
+
+void Merger::add_lab_ids(const Antigens& aSource, const Mapping& aMapping)
+{
+    auto& antigens = mMerged->antigens();
+    for (size_t no = 0; no < aSource.size(); ++no) {
+        auto& lab_ids = antigens[aMapping[no]].lab_id();
+        for (const auto& lab_id: aSource[no].lab_id()) {
+            if (std::find(lab_ids.begin(), lab_ids.end(), lab_id) == lab_ids.end())
+                lab_ids.push_back(lab_id);
+        }
+    }
+
+} // Merger::add_lab_ids
+
+// ----------------------------------------------------------------------
+
+  // homologous antigen indices of merged sera are remapped from all sources
+void Merger::add_homologous(const Sera& aSource, size_t aFirstNewSerum, const Mapping& aSerumMapping, const Mapping& aAntigenMapping)
+{
+    auto& sera = mMerged->sera();
+    for (size_t sr_no = aFirstNewSerum; sr_no < sera.size(); ++sr_no)
+        sera[sr_no].homologous().clear(); // copied from the source, indices of source antigens
+    for (size_t no = 0; no < aSource.size(); ++no) {
+        for (auto ag_no: aSource[no].homologous())
+            sera[aSerumMapping[no]].add_homologous(aAntigenMapping[ag_no]);
+    }
+
+} // Merger::add_homologous
+
+// ----------------------------------------------------------------------
+
+  // titers of the source table (or of its layer) remapped to merged antigens and sera,
+  // serum keys are sorted numerically, rows after the last antigen with titers are not stored
+void Merger::make_layer(ChartTiters::Dict& aLayer, const ChartTiters& aSource, size_t aSourceLayerNo, const Mapping& aAntigenMapping, const Mapping& aSerumMapping)
+{
+    std::vector<std::pair<std::pair<size_t, size_t>, const std::string*>> entries; // (merged antigen, merged serum), titer
+    auto add = [&](size_t ag_no, size_t sr_no, const std::string& titer) { entries.emplace_back(std::make_pair(aAntigenMapping[ag_no], aSerumMapping[sr_no]), &titer); };
+    if (aSourceLayerNo != ChartTiters::NoLayer)
+        for_each_titer(aSource.layers()[aSourceLayerNo], add);
+    else if (!aSource.list().empty())
+        for_each_titer(aSource.list(), add);
+    else
+        for_each_titer(aSource.dict(), add);
+    std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    aLayer.resize(entries.empty() ? 0 : entries.back().first.first + 1);
+    for (const auto& [ag_sr, titer]: entries)
+        aLayer[ag_sr.first].emplace_back(std::to_string(ag_sr.second), *titer);
+
+} // Merger::make_layer
+
+// ----------------------------------------------------------------------
+
+void Merger::add(const std::vector<const Chart*>& aCharts)
+{
+    struct LayerSource { const Chart* chart; size_t layer_no; size_t mapping_no; };
+    std::vector<LayerSource> layer_sources;
+    std::vector<Mapping> antigen_mappings(aCharts.size()), serum_mappings(aCharts.size());
+
+    auto& info = mMerged->chart_info();
+    for (size_t chart_no = 0; chart_no < aCharts.size(); ++chart_no) {
+        const auto& chart = *aCharts[chart_no];
+        check_compatible(chart);
+        ++mNumberOfSources;
+
+        antigen_mappings[chart_no] = add_entries(mMerged->antigens(), chart.antigens(), mAntigenIndex);
+        add_lab_ids(chart.antigens(), antigen_mappings[chart_no]);
+        const size_t first_new_serum = mMerged->number_of_sera();
+        serum_mappings[chart_no] = add_entries(mMerged->sera(), chart.sera(), mSerumIndex);
+        add_homologous(chart.sera(), first_new_serum, serum_mappings[chart_no], antigen_mappings[chart_no]);
+
+        const auto& source_info = chart.chart_info_for_json();
+        if (source_info.sources().empty())
+            info.sources().push_back(source_info);
+        else
+            info.sources().insert(info.sources().end(), source_info.sources().begin(), source_info.sources().end());
+
+          // layers: one per source table, layers of merged sources are kept as is
+        const auto& titers = chart.titers();
+        if (titers.layers().empty())
+            layer_sources.push_back({&chart, ChartTiters::NoLayer, chart_no});
+        else
+            for (size_t layer_no = 0; layer_no < titers.layers().size(); ++layer_no)
+                layer_sources.push_back({&chart, layer_no, chart_no});
+    }
+
+    auto& layers = mMerged->titers().layers();
+    const size_t first_layer = layers.size();
+    layers.resize(first_layer + layer_sources.size());
+    acmacs_chart_internal::parallel_for(layer_sources.size(), [&](size_t no) {
+        const auto& source = layer_sources[no];
+        make_layer(layers[first_layer + no], source.chart->titers(), source.layer_no, antigen_mappings[source.mapping_no], serum_mappings[source.mapping_no]);
+    });
+
+} // Merger::add
+
+// ----------------------------------------------------------------------
+
+Chart* Merger::finish()
+{
+    const size_t number_of_antigens = mMerged->number_of_antigens();
+    const auto& layers = mMerged->titers().layers();
+    auto& dict = mMerged->titers().dict();
+    dict.resize(number_of_antigens);
+    acmacs_chart_internal::parallel_for(number_of_antigens, [&](size_t ag_no) {
+        std::vector<std::pair<size_t, const std::string*>> row;
+        for (const auto& layer: layers) {
+            if (ag_no < layer.size()) {
+                for (const auto& [serum, titer]: layer[ag_no]) {
+                    size_t sr_no = 0;
+                    std::from_chars(serum.data(), serum.data() + serum.size(), sr_no);
+                    row.emplace_back(sr_no, &titer);
+                }
+            }
+        }
+        std::stable_sort(row.begin(), row.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<std::string> titers;
+        for (auto first = row.begin(); first != row.end(); ) {
+            const auto last = std::find_if(first, row.end(), [sr_no=first->first](const auto& entry) { return entry.first != sr_no; });
+            titers.clear();
+            std::transform(first, last, std::back_inserter(titers), [](const auto& entry) { return *entry.second; });
+            if (const auto titer = merge_titers(titers); !is_dont_care(titer))
+                dict[ag_no].emplace_back(std::to_string(first->first), titer);
+            first = last;
+        }
+    }, 64);
+
+    mMerged->intern_annotations();
+    return mMerged.release();
+
+} // Merger::finish
+
+// ----------------------------------------------------------------------
+
+std::string merge_titers(const std::vector<std::string>& aTiters)
+{
+    std::vector<Titer> titers;
+    for (const auto& titer: aTiters) {
+        if (!is_dont_care(titer))
+            titers.emplace_back(titer);
+    }
+    if (titers.empty())
+        return "*";
+    if (std::all_of(titers.begin() + 1, titers.end(), [&titers](const auto& titer) { return titer == titers.front(); }))
+        return titers.front();
+
+    std::vector<double> regular;
+    size_t less_than = 0, more_than = 0;
+    for (const auto& titer: titers) {
+        if (titer.is_regular())
+            regular.push_back(titer.similarity());
+        else if (titer.is_less_than())
+            less_than = less_than ? std::min(less_than, titer.value()) : titer.value();
+        else if (titer.is_more_than())
+            more_than = std::max(more_than, titer.value());
+    }
+    if (!regular.empty()) {
+        const auto [min, max] = std::minmax_element(regular.begin(), regular.end());
+        if ((*max - *min) > 2.0) // more than 4 fold difference
+            return "*";
+        const double mean = std::accumulate(regular.begin(), regular.end(), 0.0) / regular.size();
+        return std::to_string(std::lround(10.0 * std::exp2(mean)));
+    }
+    if (less_than && more_than)
+        return "*";
+    if (less_than)
+        return "<" + std::to_string(less_than);
+    return ">" + std::to_string(more_than);
+
+} // merge_titers
+
+// ----------------------------------------------------------------------
+
+Chart* merge_charts(const std::vector<const Chart*>& aCharts, MergeMatch aMatch, report_time timer)
+{
+    Timeit ti("DEBUG: merging " + std::to_string(aCharts.size()) + " charts: ", timer);
+    acmacs_chart_internal::TraceTimer trace_timer{"merge_charts"};
+    Merger merger(aMatch);
+    merger.add(aCharts);
+    return merger.finish();
+
+} // merge_charts
+
+// ----------------------------------------------------------------------
+
+Chart* merge_chart_files(const std::vector<std::string>& aFilenames, MergeMatch aMatch, report_time timer)
+{
+    Timeit ti("DEBUG: importing and merging " + std::to_string(aFilenames.size()) + " charts: ", timer);
+    acmacs_chart_internal::TraceTimer trace_timer{"merge_charts"};
+    Merger merger(aMatch);
+    const size_t batch_size = acmacs_chart_internal::number_of_threads();
+    for (size_t first = 0; first < aFilenames.size(); first += batch_size) {
+        std::vector<std::unique_ptr<Chart>> charts(std::min(batch_size, aFilenames.size() - first));
+        acmacs_chart_internal::parallel_for(charts.size(), [&](size_t no) { charts[no].reset(import_chart(aFilenames[first + no])); });
+        std::vector<const Chart*> sources(charts.size());
+        std::transform(charts.begin(), charts.end(), sources.begin(), [](const auto& chart) { return chart.get(); });
+        merger.add(sources);
+    }
+    return merger.finish();
+
+} // merge_chart_files
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
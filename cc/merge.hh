@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "acmacs-base/timeit.hh"
+
+// ----------------------------------------------------------------------
+
+class Chart;
+
+  // sources differ in virus, virus type, assay or lineage
+class MergeError : public std::runtime_error { public: using std::runtime_error::runtime_error; };
+
+  // How antigens (sera) of different sources are identified as the same entry:
+  //   Strict - full names are equal (name, reassortant, annotations, passage; serum id for sera);
+  //   IgnorePassageDate - as Strict, but dates in passages are not compared ("E4 (2017-03-01)" and "E4");
+  //   IgnorePassage - antigens differing in passage only are merged.
+  // Sera have no passage in their full names, they are always matched strictly.
+enum class MergeMatch { Strict, IgnorePassageDate, IgnorePassage };
+
+  // Merges tables into a new chart (without projections).
+  // Antigens (sera) of the sources are identified according to aMatch, the first occurrence
+  // defines merged entry, lab ids of other occurrences are added to it.
+  // Sources must have the same virus, virus type and assay (if known) and the same
+  // lineage (if both are single lineage charts), MergeError is thrown otherwise.
+  // Each source table (or each layer of a source that is itself a merge) becomes
+  // a layer of the merged chart, the merged titer of every antigen/serum pair is
+  // made from the non dont-care titers of all layers:
+  //   - the same titer in all layers: that titer;
+  //   - regular titers present: geometric mean of regular titers (thresholded ones are ignored),
+  //     "*" if regular titers differ by more than 4 fold;
+  //   - only "<" titers: the smallest threshold, only ">" titers: the largest;
+  //   - both "<" and ">": "*".
+  // Layers keep rows up to the last antigen having a titer in that layer.
+Chart* merge_charts(const std::vector<const Chart*>& aCharts, MergeMatch aMatch = MergeMatch::Strict, report_time timer = report_time::No);
+
+  // Imports source files (see import_chart) and merges them as merge_charts does.
+  // Files are imported in parallel in batches of the number of cores, each batch is added
+  // to the merge and released before the next one is imported.
+Chart* merge_chart_files(const std::vector<std::string>& aFilenames, MergeMatch aMatch = MergeMatch::Strict, report_time timer = report_time::No);
+
+  // merged titer for the titers of one antigen/serum pair in all layers (rule above)
+std::string merge_titers(const std::vector<std::string>& aTiters);
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
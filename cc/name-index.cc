@@ -0,0 +1,128 @@
+#include <cctype>
+#include <algorithm>
+#include <cstring>
+
+#include "name-index.hh"
+
+// ----------------------------------------------------------------------
+
+template <typename Func> static inline void for_each_trigram(const std::string& aName, Func aFunc)
+{
+    auto upper = [](char c) -> uint32_t { return static_cast<unsigned char>(std::toupper(static_cast<unsigned char>(c))); };
+    for (size_t pos = 0; (pos + 3) <= aName.size(); ++pos)
+        aFunc((upper(aName[pos]) << 16) | (upper(aName[pos + 1]) << 8) | upper(aName[pos + 2]));
+
+} // for_each_trigram
+
+// ----------------------------------------------------------------------
+
+acmacs_chart_internal::NameTrigramIndex::NameTrigramIndex(const std::vector<std::string>& aNames)
+    : mNameNo(aNames.size())
+{
+    std::unordered_map<std::string, size_t> name_to_no;
+    for (size_t entry_no = 0; entry_no < aNames.size(); ++entry_no) {
+        const auto [pos, inserted] = name_to_no.emplace(aNames[entry_no], mNames.size());
+        if (inserted) {
+            mNames.push_back(aNames[entry_no]);
+            mEntries.emplace_back();
+        }
+        mNameNo[entry_no] = pos->second;
+        mEntries[pos->second].push_back(entry_no);
+    }
+
+    for (size_t name_no = 0; name_no < mNames.size(); ++name_no) {
+        for_each_trigram(mNames[name_no], [this,name_no](uint32_t trigram) {
+            auto& posting = mPostings[trigram];
+            if (posting.empty() || posting.back() != name_no) // the same trigram may occur in the name several times
+                posting.push_back(static_cast<uint32_t>(name_no));
+        });
+    }
+
+} // acmacs_chart_internal::NameTrigramIndex::NameTrigramIndex
+
+// ----------------------------------------------------------------------
+
+acmacs_chart_internal::NameTrigramIndex::Candidates acmacs_chart_internal::NameTrigramIndex::candidates(std::string aName, size_t aMinShared) const
+{
+    Candidates result;
+      // cost is proportional to the total length of postings of rare trigrams, not to the number of names
+    std::vector<uint32_t> found; // name number for each shared trigram position
+    for_each_trigram(aName, [this,&result,&found](uint32_t trigram) {
+        if (const auto posting = mPostings.find(trigram); posting != mPostings.end()) {
+            if (posting->second.size() * 4 > mNames.size())
+                ++result.skipped;
+            else
+                found.insert(found.end(), posting->second.begin(), posting->second.end());
+        }
+    });
+    std::sort(found.begin(), found.end());
+    const size_t min_found = aMinShared > result.skipped ? aMinShared - result.skipped : 1;
+    for (auto first = found.begin(); first != found.end(); ) {
+        const auto last = std::upper_bound(first, found.end(), *first);
+        if (static_cast<size_t>(last - first) >= min_found)
+            result.names.emplace_back(*first, static_cast<size_t>(last - first));
+        first = last;
+    }
+    std::stable_sort(result.names.begin(), result.names.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    return result;
+
+} // acmacs_chart_internal::NameTrigramIndex::candidates
+
+// ----------------------------------------------------------------------
+
+acmacs_chart_internal::NameSuffixIndex::NameSuffixIndex(const std::vector<std::string>& aNames)
+{
+    std::unordered_map<std::string, size_t> name_to_no;
+    for (size_t entry_no = 0; entry_no < aNames.size(); ++entry_no) {
+        const auto [pos, inserted] = name_to_no.emplace(aNames[entry_no], mNameStart.size());
+        if (inserted) {
+            mNameStart.push_back(static_cast<uint32_t>(mBuffer.size()));
+            mBuffer.append(aNames[entry_no]);
+            mBuffer.push_back('\0');
+            mEntries.emplace_back();
+        }
+        mEntries[pos->second].push_back(entry_no);
+    }
+
+    mSuffixes.reserve(mBuffer.size() - mNameStart.size());
+    for (uint32_t offset = 0; offset < mBuffer.size(); ++offset) {
+        if (mBuffer[offset])
+            mSuffixes.push_back(offset);
+    }
+      // suffixes are compared up to the terminating '\0' of their name
+    const char* buffer = mBuffer.data();
+    std::sort(mSuffixes.begin(), mSuffixes.end(), [buffer](uint32_t a, uint32_t b) { return std::strcmp(buffer + a, buffer + b) < 0; });
+
+} // acmacs_chart_internal::NameSuffixIndex::NameSuffixIndex
+
+// ----------------------------------------------------------------------
+
+acmacs_chart_internal::NameSuffixIndex::Indices acmacs_chart_internal::NameSuffixIndex::find(std::string aSubstring) const
+{
+    Indices result;
+    if (aSubstring.empty()) {   // empty string is found in every name
+        for (const auto& entries: mEntries)
+            result.insert(result.end(), entries.begin(), entries.end());
+    }
+    else {
+        const char* buffer = mBuffer.data();
+        const auto compare_prefix = [buffer,&aSubstring](uint32_t offset) { return std::strncmp(buffer + offset, aSubstring.data(), aSubstring.size()); };
+        const auto first = std::lower_bound(mSuffixes.begin(), mSuffixes.end(), aSubstring, [&compare_prefix](uint32_t offset, const std::string&) { return compare_prefix(offset) < 0; });
+        const auto last = std::upper_bound(first, mSuffixes.end(), aSubstring, [&compare_prefix](const std::string&, uint32_t offset) { return compare_prefix(offset) > 0; });
+          // cost is proportional to the number of matching suffixes, not to the number of names
+        std::vector<size_t> names(static_cast<size_t>(last - first));
+        std::transform(first, last, names.begin(), [this](uint32_t offset) { return static_cast<size_t>(std::upper_bound(mNameStart.begin(), mNameStart.end(), offset) - mNameStart.begin()) - 1; });
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        for (auto name_no: names)
+            result.insert(result.end(), mEntries[name_no].begin(), mEntries[name_no].end());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+
+} // acmacs_chart_internal::NameSuffixIndex::find
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
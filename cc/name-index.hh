@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Inverted index: trigram of the upper cased name -> distinct names containing it.
+      // Used to shortlist antigens/sera before expensive string_match scoring.
+    class NameTrigramIndex
+    {
+     public:
+        using Indices = std::vector<size_t>;
+
+          // aNames: name for each antigen/serum
+        NameTrigramIndex(const std::vector<std::string>& aNames);
+
+        inline size_t number_of_names() const { return mNames.size(); }
+        inline const std::string& name(size_t aNameNo) const { return mNames[aNameNo]; }
+        inline size_t name_no(size_t aEntryNo) const { return mNameNo[aEntryNo]; }
+        inline const Indices& entries(size_t aNameNo) const { return mEntries[aNameNo]; }
+
+        class Candidates
+        {
+         public:
+            std::vector<std::pair<size_t, size_t>> names; // (name no, trigram positions of the query found in that name), most shared first
+            size_t skipped = 0;                          // trigram positions of the query not looked up (common trigrams)
+        };
+
+          // Distinct names sharing trigrams with aName, ranked by the number of shared trigram positions of aName.
+          // Trigrams found in more than a quarter of names (e.g. "A(H", "/20") are not looked up: their postings
+          // are long and select nothing. They are counted in Candidates::skipped, any name may or may not have them.
+          // Names that cannot share aMinShared positions even with all skipped trigrams are not returned.
+        Candidates candidates(std::string aName, size_t aMinShared = 1) const;
+
+     private:
+        std::vector<std::string> mNames;                                // distinct names
+        std::vector<size_t> mNameNo;                                    // for each entry: index in mNames
+        std::vector<Indices> mEntries;                                  // for each distinct name: entries having this name
+        std::unordered_map<uint32_t, std::vector<uint32_t>> mPostings;  // trigram -> indices in mNames, sorted
+
+    }; // class NameTrigramIndex
+
+// ----------------------------------------------------------------------
+
+      // Suffix array over distinct names concatenated into one '\0' separated buffer.
+      // Answers substring queries in O(length * log(total length) + number of matches).
+    class NameSuffixIndex
+    {
+     public:
+        using Indices = std::vector<size_t>;
+
+          // aNames: name for each antigen/serum
+        NameSuffixIndex(const std::vector<std::string>& aNames);
+
+          // Sorted indices of entries whose names contain aSubstring (case sensitive, like std::string::find).
+        Indices find(std::string aSubstring) const;
+
+     private:
+        std::string mBuffer;                // distinct names, each terminated by '\0'
+        std::vector<uint32_t> mNameStart;   // for each distinct name: offset in mBuffer
+        std::vector<Indices> mEntries;      // for each distinct name: entries having this name
+        std::vector<uint32_t> mSuffixes;    // offsets of suffixes in mBuffer, sorted
+
+    }; // class NameSuffixIndex
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
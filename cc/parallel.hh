@@ -0,0 +1,65 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+    inline size_t number_of_threads()
+    {
+        return std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+      // Calls aFunc(index) for each index in [0, aSize) using all available cores.
+      // Indices are handed out in chunks of aChunk elements.
+      // The first exception thrown by aFunc stops processing and is rethrown in the calling thread.
+    template <typename Func> inline void parallel_for(size_t aSize, Func aFunc, size_t aChunk = 1)
+    {
+        aChunk = std::max(aChunk, size_t{1});
+        const size_t num_threads = std::min(number_of_threads(), (aSize + aChunk - 1) / aChunk);
+        if (num_threads < 2) {
+            for (size_t index = 0; index < aSize; ++index)
+                aFunc(index);
+            return;
+        }
+
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_access;
+        auto worker = [&]() {
+            try {
+                for (size_t first = next.fetch_add(aChunk); first < aSize; first = next.fetch_add(aChunk)) {
+                    for (size_t index = first; index < std::min(first + aChunk, aSize); ++index)
+                        aFunc(index);
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock{error_access};
+                if (!error)
+                    error = std::current_exception();
+                next = aSize;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t thread_no = 1; thread_no < num_threads; ++thread_no)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread: threads)
+            thread.join();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
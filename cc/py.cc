@@ -1,9 +1,14 @@
 #include "acmacs-base/pybind11.hh"
+#include <pybind11/numpy.h>
 #include "locationdb/locdb.hh"
 
 #include "chart.hh"
+#include "chart-view.hh"
 #include "ace.hh"
 #include "lispmds.hh"
+#include "merge.hh"
+#include "binary.hh"
+#include "trace.hh"
 #include "point-style.hh"
 
 // ----------------------------------------------------------------------
@@ -41,6 +46,114 @@
 //     return style;
 // }
 
+// ----------------------------------------------------------------------
+// NumPy access
+// ----------------------------------------------------------------------
+
+  // number_of_points x number_of_dimensions, NaN for disconnected points.
+  // Coordinates of points are stored separately, i.e. it is always a copy.
+static inline py::array_t<double> layout_array(const LayoutBase& aLayout)
+{
+    const size_t number_of_points = aLayout.number_of_points();
+    size_t number_of_dimensions = 0;
+    for (size_t point_no = 0; point_no < number_of_points && number_of_dimensions == 0; ++point_no)
+        number_of_dimensions = aLayout[point_no].size();
+    py::array_t<double> result({number_of_points, number_of_dimensions});
+    auto data = result.mutable_unchecked<2>();
+    for (size_t point_no = 0; point_no < number_of_points; ++point_no) {
+        const auto& coordinates = aLayout[point_no];
+        for (size_t dim = 0; dim < number_of_dimensions; ++dim)
+            data(point_no, dim) = dim < coordinates.size() ? coordinates[dim] : std::numeric_limits<double>::quiet_NaN();
+    }
+    return result;
+}
+
+  // Read-only view of the vector data without copying, aOwner (python object owning the vector) is kept alive by the array.
+  // The view is valid while the vector is not modified.
+template <typename T> static inline py::array_t<T> readonly_view(const std::vector<T>& aData, py::handle aOwner)
+{
+    py::array_t<T> result(static_cast<py::ssize_t>(aData.size()), aData.data(), aOwner);
+    py::detail::array_proxy(result.ptr())->flags &= ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    return result;
+}
+
+  // Bulk accessors for Antigens/Sera: one native loop instead of a binding call per entry.
+template <typename AgSr, typename Func> static inline py::list string_list(const AntigensSera<AgSr>& aEntries, Func aGet)
+{
+    py::list result(aEntries.size());
+    for (size_t no = 0; no < aEntries.size(); ++no) {
+        const auto& value = aGet(aEntries[no]); // std::string or std::string_view
+        result[no] = py::str(std::data(value), std::size(value));
+    }
+    return result;
+}
+
+template <typename AgSr, typename Func> static inline py::array_t<bool> bool_mask(const AntigensSera<AgSr>& aEntries, Func aGet)
+{
+    py::array_t<bool> result(static_cast<py::ssize_t>(aEntries.size()));
+    auto* data = result.mutable_data();
+    for (size_t no = 0; no < aEntries.size(); ++no)
+        data[no] = aGet(aEntries[no]);
+    return result;
+}
+
+  // {"values": log2(titer/10) float array, "types": uint8 array of ChartTiters::TiterType}, antigens x sera,
+  // with aLayers also {"layer_values", "layer_types"}: layers x antigens x sera
+static inline py::dict titers_array(const Chart& aChart, bool aLayers)
+{
+    const size_t number_of_antigens = aChart.number_of_antigens(), number_of_sera = aChart.number_of_sera();
+    const auto& titers = aChart.titers();
+    const size_t number_of_layers = aLayers ? titers.layers().size() : 0;
+    py::array_t<double> values({number_of_antigens, number_of_sera});
+    py::array_t<uint8_t> types({number_of_antigens, number_of_sera});
+    py::array_t<double> layer_values({number_of_layers, number_of_antigens, number_of_sera});
+    py::array_t<uint8_t> layer_types({number_of_layers, number_of_antigens, number_of_sera});
+    auto* values_data = values.mutable_data();
+    auto* types_data = reinterpret_cast<ChartTiters::TiterType*>(types.mutable_data());
+    auto* layer_values_data = layer_values.mutable_data();
+    auto* layer_types_data = reinterpret_cast<ChartTiters::TiterType*>(layer_types.mutable_data());
+    {
+        py::gil_scoped_release release;
+        titers.numeric(number_of_antigens, number_of_sera, values_data, types_data);
+        const size_t layer_size = number_of_antigens * number_of_sera;
+        for (size_t layer_no = 0; layer_no < number_of_layers; ++layer_no)
+            titers.numeric(number_of_antigens, number_of_sera, layer_values_data + layer_no * layer_size, layer_types_data + layer_no * layer_size, layer_no);
+    }
+    py::dict result;
+    result["values"] = values;
+    result["types"] = types;
+    if (aLayers) {
+        result["layer_values"] = layer_values;
+        result["layer_types"] = layer_types;
+    }
+    return result;
+}
+
+// ----------------------------------------------------------------------
+// Binary serialization
+// ----------------------------------------------------------------------
+
+static inline py::bytes export_chart_binary_bytes(const Chart& aChart)
+{
+    std::string data;
+    {
+        py::gil_scoped_release release;
+        data = export_chart_binary(aChart);
+    }
+    return py::bytes(data);
+}
+
+  // bytes, bytearray or memoryview (e.g. buf of multiprocessing.shared_memory.SharedMemory) are read in place
+static inline Chart* import_chart_binary_buffer(py::buffer aData)
+{
+    const auto info = aData.request();
+    if (info.ndim > 1 || (info.ndim == 1 && info.strides[0] != info.itemsize))
+        throw std::invalid_argument("import_chart_binary: contiguous buffer expected");
+    const std::string_view data(static_cast<const char*>(info.ptr), static_cast<size_t>(info.size * info.itemsize));
+    py::gil_scoped_release release;
+    return import_chart_binary(data);
+}
+
 // ----------------------------------------------------------------------
 
 PYBIND11_MODULE(acmacs_chart_backend, m)
@@ -55,7 +168,7 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             .def("full_name", &Antigen::full_name)
             .def("abbreviated_name", &Antigen::abbreviated_name, py::doc("includes passage, reassortant, annotations"))
             .def("name_abbreviated", &Antigen::name_abbreviated, py::doc("just name without passage, reassortant, annotations"))
-            .def("location_abbreviated", &Antigen::location_abbreviated)
+            .def("location_abbreviated", &Antigen::location_abbreviated, py::doc("returns empty string if location is unknown"))
             .def("name", py::overload_cast<>(&Antigen::name, py::const_))
             .def("lineage", py::overload_cast<>(&Antigen::lineage, py::const_))
             .def("passage", py::overload_cast<>(&Antigen::passage, py::const_))
@@ -73,7 +186,7 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             .def("full_name", &Serum::full_name)
             .def("abbreviated_name", &Serum::abbreviated_name, py::doc("includes passage, reassortant, annotations"))
             .def("name_abbreviated", &Serum::name_abbreviated, py::doc("just name without passage, reassortant, annotations"))
-            .def("location_abbreviated", &Serum::location_abbreviated)
+            .def("location_abbreviated", &Serum::location_abbreviated, py::doc("returns empty string if location is unknown"))
             .def("name", py::overload_cast<>(&Serum::name, py::const_))
             .def("lineage", py::overload_cast<>(&Serum::lineage, py::const_))
             .def("passage", py::overload_cast<>(&Serum::passage, py::const_))
@@ -87,25 +200,87 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             // .def("find_in_hidb", &Serum::find_in_hidb, py::arg("hidb"), py::return_value_policy::reference)
             ;
 
+    py::class_<acmacs_chart_internal::Selection>(m, "Selection")
+            .def("indices", &acmacs_chart_internal::Selection::indices)
+            .def("count", &acmacs_chart_internal::Selection::count)
+            .def("__len__", &acmacs_chart_internal::Selection::count)
+            .def("__contains__", &acmacs_chart_internal::Selection::contains, py::arg("index"))
+            .def("__and__", [](const acmacs_chart_internal::Selection& a, const acmacs_chart_internal::Selection& b) { return a & b; })
+            .def("__or__", [](const acmacs_chart_internal::Selection& a, const acmacs_chart_internal::Selection& b) { return a | b; })
+            .def("__sub__", [](const acmacs_chart_internal::Selection& a, const acmacs_chart_internal::Selection& b) { return a - b; })
+            .def("__invert__", [](const acmacs_chart_internal::Selection& a) { return ~a; })
+            ;
+
+    py::class_<Antigens::Filter>(m, "AntigenFilter")
+            .def_static("all", &Antigens::Filter::all)
+            .def_static("indices", &Antigens::Filter::indices, py::arg("indices"))
+            .def_static("continent", &Antigens::Filter::continent, py::arg("continent"))
+            .def_static("country", &Antigens::Filter::country, py::arg("country"))
+            .def_static("clade", &Antigens::Filter::clade, py::arg("clade"))
+            .def_static("lineage", &Antigens::Filter::lineage, py::arg("lineage"))
+            .def_static("reference", &Antigens::Filter::reference)
+            .def_static("test", &Antigens::Filter::test)
+            .def_static("egg", &Antigens::Filter::egg)
+            .def_static("cell", &Antigens::Filter::cell)
+            .def_static("reassortant", &Antigens::Filter::reassortant)
+            .def_static("date_range", &Antigens::date_range_filter, py::arg("first") = std::string(), py::arg("after_last") = std::string())
+            .def("__and__", [](const Antigens::Filter& a, const Antigens::Filter& b) { return a & b; })
+            .def("__or__", [](const Antigens::Filter& a, const Antigens::Filter& b) { return a | b; })
+            .def("__invert__", [](const Antigens::Filter& a) { return ~a; })
+            ;
+
+    py::class_<Sera::Filter>(m, "SerumFilter")
+            .def_static("all", &Sera::Filter::all)
+            .def_static("indices", &Sera::Filter::indices, py::arg("indices"))
+            .def_static("continent", &Sera::Filter::continent, py::arg("continent"))
+            .def_static("country", &Sera::Filter::country, py::arg("country"))
+            .def_static("lineage", &Sera::Filter::lineage, py::arg("lineage"))
+            .def_static("egg", &Sera::Filter::egg)
+            .def_static("cell", &Sera::Filter::cell)
+            .def_static("reassortant", &Sera::Filter::reassortant)
+            .def("__and__", [](const Sera::Filter& a, const Sera::Filter& b) { return a & b; })
+            .def("__or__", [](const Sera::Filter& a, const Sera::Filter& b) { return a | b; })
+            .def("__invert__", [](const Sera::Filter& a) { return ~a; })
+            ;
+
     py::class_<Antigens>(m, "Antigens")
+            .def("select", &Antigens::select, py::arg("filter"), py::doc("evaluates AntigenFilter expression, returns Selection"))
             .def("continents", [](const Antigens& antigens, bool aExcludeReference) { Antigens::ContinentData data; antigens.continents(data, aExcludeReference); return data; }, py::arg("exclude_reference") = true)
             .def("countries", [](const Antigens& antigens) { Antigens::CountryData data; antigens.countries(data); return data; })
             .def("country", &Antigens::country, py::arg("country"))
             .def("continent", &Antigens::continent, py::arg("continent"))
-            .def("find_by_name_matching", [](const Antigens& antigens, std::string aName, string_match::score_t aScoreThreshold, bool aVerbose) { std::vector<size_t> indices; antigens.find_by_name_matching(aName, indices, aScoreThreshold, aVerbose); return indices; }, py::arg("name"), py::arg("score_threshold") = 0, py::arg("verbose") = false)
+            .def("lineage", &Antigens::lineage, py::arg("lineage"))
+            .def("clade_indices", &Antigens::clade_indices, py::arg("clade"))
+            .def("location_abbreviated", &Antigens::location_abbreviated, py::arg("index"), py::doc("cached, returns empty string if location is unknown"))
+            .def("find_by_name_matching", [](const Antigens& antigens, std::string aName, string_match::score_t aScoreThreshold, bool aVerbose) { std::vector<size_t> indices; antigens.find_by_name_matching(aName, indices, aScoreThreshold, aVerbose); return indices; }, py::arg("name"), py::arg("score_threshold") = 0, py::arg("verbose") = false, py::call_guard<py::gil_scoped_release>())
+            .def("find_by_name_matching", py::overload_cast<const std::vector<std::string>&, string_match::score_t>(&Antigens::find_by_name_matching, py::const_), py::arg("names"), py::arg("score_threshold") = 0, py::call_guard<py::gil_scoped_release>(), py::doc("matches list of names in parallel, returns list of index lists, one for each name"))
             .def("find_by_lab_id", [](const Antigens& antigens, std::string aLabId) { std::vector<size_t> indices; antigens.find_by_lab_id(aLabId, indices); return indices; }, py::arg("lab_id"))
             .def("find_by_lab_ids", [](const Antigens& antigens, std::vector<std::string> aLabIds) { std::vector<size_t> indices; for (const auto& lab_id: aLabIds) { antigens.find_by_lab_id(lab_id, indices); } return indices; }, py::arg("lab_ids"))
+            .def("find_by_lab_ids_per_id", &Antigens::find_by_lab_ids, py::arg("lab_ids"), py::doc("returns list of antigen index lists, one for each lab id"))
             .def("reference_indices", &Antigens::reference_indices)
             .def("test_indices", &Antigens::test_indices)
             .def("egg_indices", &Antigens::egg_indices)
             .def("cell_indices", &Antigens::cell_indices)
             .def("reassortant_indices", &Antigens::reassortant_indices)
             .def("date_range_indices", &Antigens::date_range_indices, py::arg("first") = std::string(), py::arg("after_last") = std::string())
+            .def("full_names", &Antigens::full_names)
+            .def("dates", [](const Antigens& antigens) { return string_list(antigens, [](const Antigen& antigen) { return antigen.date_view(); }); })
+            .def("passages", [](const Antigens& antigens) { return string_list(antigens, [](const Antigen& antigen) { return antigen.passage_view(); }); })
+            .def("is_egg_mask", [](const Antigens& antigens) { return bool_mask(antigens, [](const Antigen& antigen) { return antigen.is_egg(); }); }, py::doc("numpy bool array"))
+            .def("reference_mask", [](const Antigens& antigens) { return bool_mask(antigens, [](const Antigen& antigen) { return antigen.reference(); }); }, py::doc("numpy bool array"))
+            .def("lab_ids", [](const Antigens& antigens) { py::list result(antigens.size()); for (size_t ag_no = 0; ag_no < antigens.size(); ++ag_no) { result[ag_no] = py::cast(antigens[ag_no].lab_id()); } return result; }, py::doc("list of lab_id lists, one for each antigen"))
             .def("__getitem__", [](const Antigens& antigens, int aIndex) -> const Antigen& { if (aIndex >= 0) return antigens[static_cast<size_t>(aIndex)]; else return antigens[static_cast<size_t>(static_cast<int>(antigens.size()) + aIndex)]; })
             ;
 
     py::class_<Sera>(m, "Sera")
-            .def("find_by_name_matching", [](const Sera& sera, std::string aName, string_match::score_t aScoreThreshold, bool aVerbose) { std::vector<size_t> indices; sera.find_by_name_matching(aName, indices, aScoreThreshold, aVerbose); return indices; }, py::arg("name"), py::arg("score_threshold") = 0, py::arg("verbose") = false)
+            .def("select", &Sera::select, py::arg("filter"), py::doc("evaluates SerumFilter expression, returns Selection"))
+            .def("location_abbreviated", &Sera::location_abbreviated, py::arg("index"), py::doc("cached, returns empty string if location is unknown"))
+            .def("find_by_name_matching", [](const Sera& sera, std::string aName, string_match::score_t aScoreThreshold, bool aVerbose) { std::vector<size_t> indices; sera.find_by_name_matching(aName, indices, aScoreThreshold, aVerbose); return indices; }, py::arg("name"), py::arg("score_threshold") = 0, py::arg("verbose") = false, py::call_guard<py::gil_scoped_release>())
+            .def("find_by_name_matching", py::overload_cast<const std::vector<std::string>&, string_match::score_t>(&Sera::find_by_name_matching, py::const_), py::arg("names"), py::arg("score_threshold") = 0, py::call_guard<py::gil_scoped_release>(), py::doc("matches list of names in parallel, returns list of index lists, one for each name"))
+            .def("full_names", &Sera::full_names)
+            .def("passages", [](const Sera& sera) { return string_list(sera, [](const Serum& serum) { return serum.passage_view(); }); })
+            .def("serum_ids", [](const Sera& sera) { return string_list(sera, [](const Serum& serum) { return serum.serum_id(); }); })
+            .def("is_egg_mask", [](const Sera& sera) { return bool_mask(sera, [](const Serum& serum) { return serum.is_egg(); }); }, py::doc("numpy bool array"))
             .def("__getitem__", [](const Sera& sera, int aIndex) -> const Serum& { if (aIndex >= 0) return sera[static_cast<size_t>(aIndex)]; else return sera[static_cast<size_t>(static_cast<int>(sera.size()) + aIndex)]; })
             ;
 
@@ -124,6 +299,11 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             .def("subset", py::overload_cast<>(&ChartInfo::subset, py::const_))
             .def("type", &ChartInfo::type_as_string)
             .def("make_name", &ChartInfo::make_name)
+            .def("number_of_sources", [](const ChartInfo& aInfo) { return aInfo.sources().size(); })
+            .def("sources_by_date", &ChartInfo::sources_by_date, py::arg("date"))
+            .def("sources_by_lab", &ChartInfo::sources_by_lab, py::arg("lab"))
+            .def("sources_by_assay", &ChartInfo::sources_by_assay, py::arg("assay"))
+            .def("sources_in_date_range", &ChartInfo::sources_in_date_range, py::arg("first") = std::string(), py::arg("after_last") = std::string(), py::doc("indices of sources with date in [first, after_last), empty bound means no limit"))
             ;
 
     py::class_<acmacs::Transformation>(m, "Transformation")
@@ -134,13 +314,18 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             .def("number_of_points", &LayoutBase::number_of_points)
             .def("number_of_dimensions", &LayoutBase::number_of_dimensions)
             .def("__getitem__", [](const LayoutBase& aLayout, size_t aIndex) -> std::vector<double> { return aLayout[aIndex]; }, py::arg("index"))
+            .def("__array__", &layout_array, py::doc("number_of_points x number_of_dimensions array, NaN for disconnected points"))
             ;
 
     py::class_<Projection>(m, "Projection")
             .def("stress", py::overload_cast<>(&Projection::stress, py::const_))
             .def("minimum_column_basis", &Projection::minimum_column_basis_for_json)
-            .def("layout", py::overload_cast<>(&Projection::layout, py::const_), py::return_value_policy::reference)
-            .def("transformation", py::overload_cast<>(&Projection::transformation, py::const_), py::return_value_policy::reference)
+            .def("layout", py::overload_cast<>(&Projection::layout, py::const_), py::return_value_policy::reference_internal)
+            .def("transformation", py::overload_cast<>(&Projection::transformation, py::const_), py::return_value_policy::reference_internal)
+            .def("layout_array", [](const Projection& aProjection) { return layout_array(aProjection.layout()); }, py::doc("number_of_points x number_of_dimensions numpy array, NaN for disconnected points"))
+            .def("column_bases", [](py::object aSelf) { return readonly_view(aSelf.cast<const Projection&>().column_bases_for_json(), aSelf); }, py::doc("read-only numpy view of the stored column bases (empty if not stored), valid while projection is not modified"))
+            .def("gradient_multipliers", [](py::object aSelf) { return readonly_view(aSelf.cast<const Projection&>().gradient_multipliers(), aSelf); }, py::doc("read-only numpy view, valid while projection is not modified"))
+            .def("titer_multipliers", [](py::object aSelf) { return readonly_view(aSelf.cast<const Projection&>().titer_multipliers(), aSelf); }, py::doc("read-only numpy view, valid while projection is not modified"))
             ;
 
     py::class_<Titer>(m, "Titer")
@@ -152,6 +337,12 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             .def("max_for_serum", &ChartTiters::max_for_serum, py::arg("sr_no"))
             ;
 
+    py::class_<FullNameMatch>(m, "FullNameMatch")
+            .def_readonly("found", &FullNameMatch::found)
+            .def_readonly("not_found", &FullNameMatch::not_found)
+            .def_property_readonly("mapping", [](const FullNameMatch& aMatch) { py::list list; for (auto index: aMatch.mapping) { if (index == AntigenSerumNotFound) list.append(-1); else list.append(index); } return list; }, py::doc("for each entry of the first chart: index of the same entry in another chart or -1"))
+            ;
+
     py::class_<ChartPlotSpecStyle>(m, "ChartPlotSpecStyle")
             .def("shown", py::overload_cast<>(&ChartPlotSpecStyle::shown, py::const_))
             .def("fill_color", py::overload_cast<>(&ChartPlotSpecStyle::fill_color, py::const_))
@@ -171,24 +362,59 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
             .def("number_of_antigens", &Chart::number_of_antigens)
             .def("number_of_sera", &Chart::number_of_sera)
             .def("number_of_projections", &Chart::number_of_projections)
-            .def("antigens", py::overload_cast<>(&Chart::antigens), py::return_value_policy::reference)
-            .def("sera", py::overload_cast<>(&Chart::sera), py::return_value_policy::reference)
+            .def("antigens", py::overload_cast<>(&Chart::antigens, py::const_), py::return_value_policy::reference) // const: must not unshare antigens of a clone
+            .def("sera", py::overload_cast<>(&Chart::sera, py::const_), py::return_value_policy::reference)
             .def("antigen", py::overload_cast<size_t>(&Chart::antigen, py::const_), py::arg("no"), py::return_value_policy::reference)
             .def("serum", py::overload_cast<size_t>(&Chart::serum, py::const_), py::arg("no"), py::return_value_policy::reference)
             .def("lineage", &Chart::lineage)
             .def("make_name", &Chart::make_name, py::arg("projection_no") = -1)
             // .def("vaccines", &Chart::vaccines, py::arg("name"), py::arg("hidb"))
             // .def("table_id", &Chart::table_id)
-            .def("find_homologous_antigen_for_sera", &Chart::find_homologous_antigen_for_sera)
+            .def("find_homologous_antigen_for_sera", &Chart::find_homologous_antigen_for_sera, py::call_guard<py::gil_scoped_release>())
             .def("chart_info", py::overload_cast<>(&Chart::chart_info, py::const_), py::return_value_policy::reference)
             .def("titers", py::overload_cast<>(&Chart::titers, py::const_), py::return_value_policy::reference)
-            .def("serum_circle_radius", &Chart::serum_circle_radius, py::arg("antigen_no"), py::arg("serum_no"), py::arg("projection_no") = 0, py::arg("verbose") = false)
-            .def("serum_coverage", [](const Chart& aChart, size_t aAntigenNo, size_t aSerumNo) -> std::vector<std::vector<size_t>> { std::vector<size_t> within, outside; aChart.serum_coverage(aAntigenNo, aSerumNo, within, outside); return {within, outside}; } , py::arg("antigen_no"), py::arg("serum_no"))
+            .def("serum_circle_radius", &Chart::serum_circle_radius, py::arg("antigen_no"), py::arg("serum_no"), py::arg("projection_no") = 0, py::arg("verbose") = false, py::call_guard<py::gil_scoped_release>())
+            .def("serum_coverage", [](const Chart& aChart, size_t aAntigenNo, size_t aSerumNo) -> std::vector<std::vector<size_t>> { std::vector<size_t> within, outside; aChart.serum_coverage(aAntigenNo, aSerumNo, within, outside); return {within, outside}; } , py::arg("antigen_no"), py::arg("serum_no"), py::call_guard<py::gil_scoped_release>())
             .def("antigens_not_found_in", [](const Chart& aChart, const Chart& aNother) -> std::vector<size_t> { auto gen = aChart.antigens_not_found_in(aNother); return {gen.begin(), gen.end()}; }, py::arg("another_chart"))
-            .def("projection", py::overload_cast<size_t>(&Chart::projection, py::const_), py::arg("projection_no") = 0, py::return_value_policy::reference)
+            .def("match_antigens", py::overload_cast<const Chart&>(&Chart::match_antigens, py::const_), py::arg("another_chart"), py::doc("matches antigens by full name, returns FullNameMatch"))
+            .def("match_antigens", py::overload_cast<const std::vector<const Chart*>&>(&Chart::match_antigens, py::const_), py::arg("other_charts"), py::doc("matches antigens by full name against each chart in the list, returns list of FullNameMatch"))
+            .def("match_sera", py::overload_cast<const Chart&>(&Chart::match_sera, py::const_), py::arg("another_chart"), py::doc("matches sera by full name, returns FullNameMatch"))
+            .def("match_sera", py::overload_cast<const std::vector<const Chart*>&>(&Chart::match_sera, py::const_), py::arg("other_charts"), py::doc("matches sera by full name against each chart in the list, returns list of FullNameMatch"))
+            .def("projection", py::overload_cast<size_t>(&Chart::projection, py::const_), py::arg("projection_no") = 0, py::return_value_policy::reference_internal) // keeps chart alive while the projection (and numpy views of its data) is in use
             .def("plot_spec", py::overload_cast<>(&Chart::plot_spec, py::const_), py::return_value_policy::reference)
+            .def("titers_array", &titers_array, py::arg("layers") = false, py::doc("whole titer table as numpy arrays: {\"values\": log2(titer/10), NaN for dont-care; \"types\": 0 dont-care, 1 regular, 2 less than, 3 more than}, with layers=True also layer_values and layer_types (layers x antigens x sera)"))
+            .def("column_bases", [](py::object aSelf) { return readonly_view(aSelf.cast<const Chart&>().column_bases_for_json(), aSelf); }, py::doc("read-only numpy view of the chart column bases (empty if not stored), valid while chart is not modified"))
+            .def("clone", [](const Chart& aChart) { return new Chart(aChart); }, py::doc("Copy sharing antigens, sera, titers, projections and plot spec with the original, a component is copied when it is modified."))
+            .def("memory_usage", &Chart::memory_usage, py::call_guard<py::gil_scoped_release>(), py::doc("bytes used by the chart by component (antigens.name, titers.dict, projections[0].layout, projections[0].titer_multipliers, ...) and total, incl. heap memory of strings and capacity of vectors; string_pool is shared by all charts and not in total"))
+            .def(py::pickle(&export_chart_binary_bytes, &import_chart_binary_buffer))
+            .def("view", [](const Chart& aChart, const std::vector<size_t>& aAntigens, const std::vector<size_t>& aSera) { return new ChartView(aChart, aAntigens, aSera); }, py::arg("antigens"), py::arg("sera"), py::keep_alive<0, 1>(), py::doc("Read-only view of the chart subset, nothing is copied. Chart must not be modified while view is in use."))
         ;
 
+    py::class_<ProjectionView>(m, "ProjectionView")
+            .def("stress", &ProjectionView::stress)
+            .def("minimum_column_basis", &ProjectionView::minimum_column_basis_for_json)
+            .def("layout", py::overload_cast<>(&ProjectionView::layout, py::const_), py::return_value_policy::reference_internal)
+            .def("layout_array", [](const ProjectionView& aProjection) { return layout_array(aProjection.layout()); }, py::doc("number_of_points x number_of_dimensions numpy array, NaN for disconnected points"))
+            .def("column_bases", [](const ProjectionView& aProjection) { const auto column_bases = aProjection.column_bases_for_json(); return py::array_t<double>(static_cast<py::ssize_t>(column_bases.size()), column_bases.data()); }, py::doc("stored column bases remapped to the view, copy"))
+            .def("transformation", py::overload_cast<>(&ProjectionView::transformation, py::const_), py::return_value_policy::reference_internal)
+            ;
+
+    py::class_<ChartView>(m, "ChartView")
+            .def("number_of_antigens", &ChartView::number_of_antigens)
+            .def("number_of_sera", &ChartView::number_of_sera)
+            .def("number_of_projections", &ChartView::number_of_projections)
+            .def("antigen_indices", &ChartView::antigen_indices, py::doc("indices of antigens of the view in the parent chart"))
+            .def("serum_indices", &ChartView::serum_indices, py::doc("indices of sera of the view in the parent chart"))
+            .def("antigen", &ChartView::antigen, py::arg("no"), py::return_value_policy::reference_internal)
+            .def("serum", &ChartView::serum, py::arg("no"), py::return_value_policy::reference_internal, py::doc("serum of the parent chart, its homologous() refers to antigens of the parent"))
+            .def("homologous", &ChartView::homologous, py::arg("sr_no"), py::doc("homologous antigens of the serum of the view, indices of antigens in the view"))
+            .def("lineage", &ChartView::lineage)
+            .def("make_name", &ChartView::make_name, py::arg("projection_no") = -1)
+            .def("chart_info", &ChartView::chart_info, py::return_value_policy::reference_internal)
+            .def("titer", [](const ChartView& aView, size_t aAntigenNo, size_t aSerumNo) { return aView.titers().get(aAntigenNo, aSerumNo); }, py::arg("ag_no"), py::arg("sr_no"))
+            .def("projection", [](const ChartView& aView, size_t aProjectionNo) -> const ProjectionView& { return aView.projections().at(aProjectionNo); }, py::arg("projection_no") = 0, py::return_value_policy::reference_internal)
+            ;
+
 #pragma GCC diagnostic push
 #ifdef __clang__
 #pragma GCC diagnostic ignored "-Wexit-time-destructors"
@@ -206,18 +432,42 @@ PYBIND11_MODULE(acmacs_chart_backend, m)
         }
     });
 
-    m.def("import_chart", [](std::string data, bool timer) { return import_chart(data, timer ? report_time::Yes : report_time::No); }, py::arg("data"), py::arg("timer") = false, py::doc("Imports chart from a buffer or file in the ace format."));
-    m.def("import_chart", [](py::bytes data, bool timer) { return import_chart(data, timer ? report_time::Yes : report_time::No); }, py::arg("data"), py::arg("timer") = false, py::doc("Imports chart from a buffer or file in the ace format."));
-    m.def("export_chart", [](std::string filename, const Chart& chart, bool timer) { export_chart(filename, chart, timer ? report_time::Yes : report_time::No); }, py::arg("filename"), py::arg("chart"), py::arg("timer") = false, py::doc("Exports chart into a file in the ace format."));
+    m.def("import_chart", [](std::string data, bool timer) { return import_chart(data, timer ? report_time::Yes : report_time::No); }, py::arg("data"), py::arg("timer") = false, py::call_guard<py::gil_scoped_release>(), py::doc("Imports chart from a buffer or file in the ace format."));
+    m.def("import_chart", [](py::bytes data, bool timer) { std::string buffer = data; py::gil_scoped_release release; return import_chart(buffer, timer ? report_time::Yes : report_time::No); }, py::arg("data"), py::arg("timer") = false, py::doc("Imports chart from a buffer or file in the ace format."));
+    m.def("export_chart", [](std::string filename, const Chart& chart, bool timer) { export_chart(filename, chart, timer ? report_time::Yes : report_time::No); }, py::arg("filename"), py::arg("chart"), py::arg("timer") = false, py::call_guard<py::gil_scoped_release>(), py::doc("Exports chart into a file in the ace format."));
       // m.def("export_chart", py::overload_cast<std::string, const Chart&, const std::vector<PointStyle>&>(&export_chart), py::arg("filename"), py::arg("chart"), py::arg("point_styles"), py::doc("Exports chart into a file in the ace format."));
-    m.def("export_chart_lispmds", py::overload_cast<std::string, const Chart&>(&export_chart_lispmds), py::arg("filename"), py::arg("chart"), py::doc("Exports chart into a file in the lispmds save format."));
-    m.def("export_chart_lispmds", py::overload_cast<std::string, const Chart&, const std::vector<PointStyle>&, const acmacs::Transformation&>(&export_chart_lispmds), py::arg("filename"), py::arg("chart"), py::arg("point_styles"), py::arg("transformation"), py::doc("Exports chart into a file in the lispmds save format."));
+    m.def("export_chart", [](std::string filename, const ChartView& chart, bool timer) { export_chart(filename, chart, timer ? report_time::Yes : report_time::No); }, py::arg("filename"), py::arg("chart"), py::arg("timer") = false, py::call_guard<py::gil_scoped_release>(), py::doc("Exports chart view into a file in the ace format."));
+    py::enum_<MergeMatch>(m, "MergeMatch")
+            .value("Strict", MergeMatch::Strict)
+            .value("IgnorePassageDate", MergeMatch::IgnorePassageDate)
+            .value("IgnorePassage", MergeMatch::IgnorePassage)
+            ;
+    m.def("merge_charts", [](const std::vector<const Chart*>& charts, MergeMatch match, bool timer) { return merge_charts(charts, match, timer ? report_time::Yes : report_time::No); }, py::arg("charts"), py::arg("match") = MergeMatch::Strict, py::arg("timer") = false, py::call_guard<py::gil_scoped_release>(), py::doc("Merges tables matching antigens by full name or, depending on match, ignoring passage date or passage, sera by full name. Each source becomes a titer layer. Raises RuntimeError if sources differ in virus, virus type, assay or lineage."));
+    m.def("merge_chart_files", [](const std::vector<std::string>& filenames, MergeMatch match, bool timer) { return merge_chart_files(filenames, match, timer ? report_time::Yes : report_time::No); }, py::arg("filenames"), py::arg("match") = MergeMatch::Strict, py::arg("timer") = false, py::call_guard<py::gil_scoped_release>(), py::doc("Imports charts in parallel batches of the number of cores and merges them, see merge_charts."));
+    m.def("export_chart_binary", &export_chart_binary_bytes, py::arg("chart"), py::doc("Compact native serialization for passing the chart to another process, not for storage."));
+    m.def("import_chart_binary", &import_chart_binary_buffer, py::arg("data"), py::doc("Imports chart from export_chart_binary data, bytes or any contiguous buffer (e.g. shared memory) is read without copying."));
+    m.def("export_chart_lispmds", py::overload_cast<std::string, const Chart&>(&export_chart_lispmds), py::arg("filename"), py::arg("chart"), py::call_guard<py::gil_scoped_release>(), py::doc("Exports chart into a file in the lispmds save format."));
+    m.def("export_chart_lispmds", py::overload_cast<std::string, const Chart&, const std::vector<PointStyle>&, const acmacs::Transformation&>(&export_chart_lispmds), py::arg("filename"), py::arg("chart"), py::arg("point_styles"), py::arg("transformation"), py::call_guard<py::gil_scoped_release>(), py::doc("Exports chart into a file in the lispmds save format."));
+    m.def("export_chart_lispmds", py::overload_cast<std::string, const ChartView&>(&export_chart_lispmds), py::arg("filename"), py::arg("chart"), py::call_guard<py::gil_scoped_release>(), py::doc("Exports chart view into a file in the lispmds save format."));
+    m.def("export_chart_lispmds", py::overload_cast<std::string, const ChartView&, const std::vector<PointStyle>&, const acmacs::Transformation&>(&export_chart_lispmds), py::arg("filename"), py::arg("chart"), py::arg("point_styles"), py::arg("transformation"), py::call_guard<py::gil_scoped_release>(), py::doc("Exports chart view into a file in the lispmds save format."));
 
       // ----------------------------------------------------------------------
       //
       // ----------------------------------------------------------------------
 
     m.def("virus_name_match_threshold", &virus_name::match_threshold, py::arg("name"), py::doc("Extracts virus name without passage, reassortant, extra, etc. and calculates match threshold (to use with antigens.find_by_name_matching), match threshold is a square of virus name length."));
+
+      // ----------------------------------------------------------------------
+      // Tracing, see trace.hh
+      // ----------------------------------------------------------------------
+
+    m.def("trace_enable", &acmacs_chart_internal::enable_trace, py::arg("enable") = true, py::doc("Switches recording of timers and counters on or off, also enabled by ACMACS_CHART_TRACE=<file.json> in the environment (trace is written to the file at exit)."));
+    m.def("trace_enabled", &acmacs_chart_internal::trace_enabled);
+    m.def("trace_reset", &acmacs_chart_internal::reset_trace, py::doc("Clears counters, timer totals and recorded events."));
+    m.def("trace_counters", &acmacs_chart_internal::trace_counters, py::doc("{name: count}: titers_parsed, cells_accessed, name_matches, locdb_lookups, component_copies (copies of shared chart components)"));
+    m.def("trace_timers", []() { std::map<std::string, std::pair<size_t, double>> result; for (const auto& [name, total]: acmacs_chart_internal::trace_timers()) result[name] = {total.calls, total.seconds}; return result; }, py::doc("{name: (calls, seconds)}"));
+    m.def("trace_chrome_json", &acmacs_chart_internal::trace_chrome_json, py::call_guard<py::gil_scoped_release>(), py::doc("Recorded events and counters in the Chrome trace event format (chrome://tracing, Perfetto)."));
+    m.def("export_trace", &acmacs_chart_internal::export_trace, py::arg("filename"), py::call_guard<py::gil_scoped_release>(), py::doc("Writes trace_chrome_json() to the file."));
 }
 
 // ----------------------------------------------------------------------
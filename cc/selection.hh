@@ -0,0 +1,196 @@
+#pragma once
+
+#include <variant>
+#include <memory>
+#include <functional>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+#include "acmacs-chart-1/bitset.hh"
+#include "acmacs-chart-1/group-index.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Subset of antigens (sera) of a chart, kept either as sorted list of indices
+      // (small subsets) or as bitset (large subsets and results of NOT).
+    class Selection
+    {
+     public:
+        using Indices = Bitset::Indices;
+
+        inline Selection(size_t aSize = 0) : mSize{aSize}, mData{Indices{}} {}
+        inline Selection(size_t aSize, Indices aSortedIndices) : mSize{aSize}, mData{std::move(aSortedIndices)} {}
+        inline Selection(Bitset aBitset) : mSize{aBitset.size()}, mData{std::move(aBitset)} {}
+        inline static Selection all(size_t aSize) { return Selection(Bitset(aSize, true)); }
+
+        inline size_t size() const { return mSize; } // number of antigens (sera) in the chart
+        inline bool dense() const { return std::holds_alternative<Bitset>(mData); }
+        inline size_t count() const { return dense() ? std::get<Bitset>(mData).count() : std::get<Indices>(mData).size(); }
+        inline bool empty() const { return dense() ? std::get<Bitset>(mData).none() : std::get<Indices>(mData).empty(); }
+        inline bool contains(size_t aIndex) const
+            {
+                if (dense())
+                    return aIndex < mSize && std::get<Bitset>(mData).test(aIndex);
+                const auto& indices = std::get<Indices>(mData);
+                return std::binary_search(indices.begin(), indices.end(), aIndex);
+            }
+
+        inline Indices indices() const { return dense() ? std::get<Bitset>(mData).indices() : std::get<Indices>(mData); }
+        inline operator Indices() const { return indices(); }
+        inline Bitset bitset() const { return dense() ? std::get<Bitset>(mData) : Bitset(mSize, std::get<Indices>(mData)); }
+
+          // removes from aIndices entries not in this selection
+        inline void filter(Indices& aIndices) const { aIndices.erase(std::remove_if(aIndices.begin(), aIndices.end(), [this](size_t aIndex) { return !contains(aIndex); }), aIndices.end()); }
+
+        inline Selection operator & (const Selection& aNother) const
+            {
+                if (dense() && aNother.dense())
+                    return Selection(std::get<Bitset>(mData) & std::get<Bitset>(aNother.mData));
+                if (!dense() && !aNother.dense()) {
+                    const auto& first = std::get<Indices>(mData);
+                    const auto& second = std::get<Indices>(aNother.mData);
+                    Indices result;
+                    std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(result));
+                    return Selection(mSize, std::move(result));
+                }
+                const auto& [sparse, bits] = dense() ? std::tie(std::get<Indices>(aNother.mData), std::get<Bitset>(mData)) : std::tie(std::get<Indices>(mData), std::get<Bitset>(aNother.mData));
+                Indices result;
+                std::copy_if(sparse.begin(), sparse.end(), std::back_inserter(result), [&bits=bits](size_t aIndex) { return bits.test(aIndex); });
+                return Selection(mSize, std::move(result));
+            }
+
+        inline Selection operator | (const Selection& aNother) const
+            {
+                if (!dense() && !aNother.dense()) {
+                    const auto& first = std::get<Indices>(mData);
+                    const auto& second = std::get<Indices>(aNother.mData);
+                    Indices result;
+                    std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(result));
+                    return Selection(mSize, std::move(result));
+                }
+                return Selection(bitset() | aNother.bitset());
+            }
+
+        inline Selection operator ~ () const { return Selection(~bitset()); }
+        inline Selection operator - (const Selection& aNother) const { return *this & ~aNother; }
+
+     private:
+        size_t mSize;
+        std::variant<Indices, Bitset> mData;
+
+    }; // class Selection
+
+// ----------------------------------------------------------------------
+
+      // Composable filter expression over antigens (sera). Group leaves are taken from
+      // GroupIndex without looking at entries, all predicate leaves of the expression
+      // are evaluated together in a single pass over entries, then results are combined
+      // with bitset operations.
+    template <typename AgSr> class SelectionFilter
+    {
+     public:
+          // type erased: filters are built and combined at run time (also from python),
+          // C++ callers needing an inlined predicate use AntigensSera::select_if()
+        using Predicate = std::function<bool (const AgSr&)>;
+        using Group = GroupIndex::Group;
+        using Indices = Selection::Indices;
+
+        inline static SelectionFilter all() { return make(Node{Kind::All}); }
+        inline static SelectionFilter group(Group aGroup, std::string aName) { Node node{Kind::Group}; node.group = aGroup; node.name = aName; return make(std::move(node)); }
+        inline static SelectionFilter predicate(Predicate aPredicate) { Node node{Kind::Predicate}; node.predicate = aPredicate; return make(std::move(node)); }
+        inline static SelectionFilter indices(Indices aIndices) { Node node{Kind::Indices}; std::sort(aIndices.begin(), aIndices.end()); aIndices.erase(std::unique(aIndices.begin(), aIndices.end()), aIndices.end()); node.indices = std::move(aIndices); return make(std::move(node)); }
+
+        inline static SelectionFilter continent(std::string aContinent) { return group(Group::Continent, aContinent); }
+        inline static SelectionFilter country(std::string aCountry) { return group(Group::Country, aCountry); }
+        inline static SelectionFilter clade(std::string aClade) { return group(Group::Clade, aClade); }
+        inline static SelectionFilter lineage(std::string aLineage) { return group(Group::Lineage, aLineage); }
+        inline static SelectionFilter reference() { return group(Group::Attribute, GroupIndex::Reference); }
+        inline static SelectionFilter test() { return group(Group::Attribute, GroupIndex::Test); }
+        inline static SelectionFilter egg() { return group(Group::Attribute, GroupIndex::Egg); }
+        inline static SelectionFilter cell() { return group(Group::Attribute, GroupIndex::Cell); }
+        inline static SelectionFilter reassortant() { return group(Group::Attribute, GroupIndex::Reassortant); }
+
+        inline SelectionFilter operator & (const SelectionFilter& aNother) const { return combine(Kind::And, aNother); }
+        inline SelectionFilter operator | (const SelectionFilter& aNother) const { return combine(Kind::Or, aNother); }
+        inline SelectionFilter operator ~ () const { Node node{Kind::Not}; node.left = mRoot; return make(std::move(node)); }
+
+        inline Selection evaluate(const std::vector<AgSr>& aAgSr, const GroupIndex& aGroupIndex) const
+            {
+                std::vector<const Node*> predicates;
+                collect_predicates(*mRoot, predicates);
+                std::vector<Bitset> predicate_values(predicates.size(), Bitset(aAgSr.size()));
+                if (!predicates.empty()) {
+                    for (size_t no = 0; no < aAgSr.size(); ++no) {
+                        for (size_t predicate_no = 0; predicate_no < predicates.size(); ++predicate_no) {
+                            if (predicates[predicate_no]->predicate(aAgSr[no]))
+                                predicate_values[predicate_no].set(no);
+                        }
+                    }
+                }
+                return evaluate(*mRoot, aAgSr.size(), aGroupIndex, predicates, predicate_values);
+            }
+
+     private:
+        enum class Kind { All, Group, Predicate, Indices, And, Or, Not };
+
+        struct Node
+        {
+            inline Node(Kind aKind) : kind{aKind} {}
+
+            Kind kind;
+            Group group = Group::Attribute;
+            std::string name;
+            Predicate predicate;
+            Indices indices;
+            std::shared_ptr<const Node> left, right;
+        };
+
+        std::shared_ptr<const Node> mRoot;
+
+        inline static SelectionFilter make(Node&& aNode) { SelectionFilter result; result.mRoot = std::make_shared<const Node>(std::move(aNode)); return result; }
+        inline SelectionFilter combine(Kind aKind, const SelectionFilter& aNother) const { Node node{aKind}; node.left = mRoot; node.right = aNother.mRoot; return make(std::move(node)); }
+
+        inline static void collect_predicates(const Node& aNode, std::vector<const Node*>& aPredicates)
+            {
+                if (aNode.kind == Kind::Predicate)
+                    aPredicates.push_back(&aNode);
+                if (aNode.left)
+                    collect_predicates(*aNode.left, aPredicates);
+                if (aNode.right)
+                    collect_predicates(*aNode.right, aPredicates);
+            }
+
+        inline static Selection evaluate(const Node& aNode, size_t aSize, const GroupIndex& aGroupIndex, const std::vector<const Node*>& aPredicates, const std::vector<Bitset>& aPredicateValues)
+            {
+                auto sub = [&](const auto& aSubNode) { return evaluate(*aSubNode, aSize, aGroupIndex, aPredicates, aPredicateValues); };
+                switch (aNode.kind) {
+                  case Kind::All:
+                      return Selection::all(aSize);
+                  case Kind::Group:
+                      return Selection(aGroupIndex.get(aNode.group, aNode.name));
+                  case Kind::Predicate:
+                      return Selection(aPredicateValues[static_cast<size_t>(std::find(aPredicates.begin(), aPredicates.end(), &aNode) - aPredicates.begin())]);
+                  case Kind::Indices:
+                      return Selection(aSize, Indices(aNode.indices.begin(), std::lower_bound(aNode.indices.begin(), aNode.indices.end(), aSize)));
+                  case Kind::And:
+                      return sub(aNode.left) & sub(aNode.right);
+                  case Kind::Or:
+                      return sub(aNode.left) | sub(aNode.right);
+                  case Kind::Not:
+                      return ~sub(aNode.left);
+                }
+                return Selection(aSize);
+            }
+
+    }; // class SelectionFilter<AgSr>
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
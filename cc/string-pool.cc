@@ -0,0 +1,71 @@
+#include <unordered_set>
+#include <mutex>
+#include <array>
+
+#include "string-pool.hh"
+
+// ----------------------------------------------------------------------
+
+struct StringPoolShard
+{
+    std::mutex access;
+    std::unordered_set<std::string> values; // node based: addresses of elements are stable
+};
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#pragma GCC diagnostic ignored "-Wglobal-constructors"
+#endif
+
+static std::array<StringPoolShard, 64> sPool;
+
+#pragma GCC diagnostic pop
+
+// ----------------------------------------------------------------------
+
+const std::string* acmacs_chart_internal::StringPool::intern(std::string_view aValue)
+{
+      // low bits of the hash select the bucket within a shard, take shard from the high bits
+    auto& shard = sPool[(std::hash<std::string_view>{}(aValue) >> (sizeof(size_t) * 8 - 6)) % sPool.size()];
+    std::lock_guard<std::mutex> lock{shard.access};
+    return &*shard.values.emplace(aValue).first;
+
+} // acmacs_chart_internal::StringPool::intern
+
+// ----------------------------------------------------------------------
+
+size_t acmacs_chart_internal::StringPool::size()
+{
+    size_t result = 0;
+    for (auto& shard: sPool) {
+        std::lock_guard<std::mutex> lock{shard.access};
+        result += shard.values.size();
+    }
+    return result;
+
+} // acmacs_chart_internal::StringPool::size
+
+// ----------------------------------------------------------------------
+
+size_t acmacs_chart_internal::StringPool::memory_usage()
+{
+    static const size_t sso_capacity = std::string{}.capacity();
+    size_t result = 0;
+    for (auto& shard: sPool) {
+        std::lock_guard<std::mutex> lock{shard.access};
+          // node: next pointer, string, cached hash
+        result += shard.values.size() * (sizeof(void*) + sizeof(std::string) + sizeof(size_t)) + shard.values.bucket_count() * sizeof(void*);
+        for (const auto& value: shard.values) {
+            if (value.capacity() > sso_capacity)
+                result += value.capacity() + 1;
+        }
+    }
+    return result;
+
+} // acmacs_chart_internal::StringPool::memory_usage
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
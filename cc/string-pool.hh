@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Process-wide pool of immutable strings shared by all charts. Strings are never
+      // removed, their addresses are stable, so reading pooled values needs no locking.
+      // The pool is split into shards selected by hash, each with its own mutex, so that
+      // charts imported in parallel rarely wait for each other.
+      // Since nothing is freed, only low cardinality values must be pooled: the number of
+      // distinct values and not the number of charts loaded bounds the pool size.
+    class StringPool
+    {
+     public:
+          // returns pooled copy of aValue, the same object for equal values (thread safe)
+        static const std::string* intern(std::string_view aValue);
+        static size_t size();
+          // bytes used by the pool, incl. estimated overhead of the hash table
+        static size_t memory_usage();
+
+    }; // class StringPool
+
+// ----------------------------------------------------------------------
+
+      // Field value kept in StringPool: pointer size, equal values share storage.
+      // Only for low cardinality fields without non-const accessors (semantic attributes, label texts),
+      // not for passages or dates.
+    class PooledString
+    {
+     public:
+        inline PooledString() = default;
+        inline PooledString(std::string_view aValue) { assign(aValue); }
+
+        inline void assign(std::string_view aValue) { mValue = aValue.empty() ? nullptr : StringPool::intern(aValue); }
+        inline void assign(const char* str, size_t length) { assign(std::string_view(str, length)); }
+        inline PooledString& operator=(std::string_view aValue) { assign(aValue); return *this; }
+
+        inline const std::string& str() const { return mValue ? *mValue : empty_string(); }
+        inline std::string_view view() const { return mValue ? std::string_view(*mValue) : std::string_view{}; }
+        inline operator const std::string&() const { return str(); }
+        inline bool empty() const { return mValue == nullptr; }
+        inline size_t size() const { return mValue ? mValue->size() : 0; }
+        inline size_t find(char c) const { return str().find(c); }
+
+          // values from the same pool are equal iff they are the same object
+        inline bool operator==(const PooledString& aNother) const { return mValue == aNother.mValue; }
+        inline bool operator!=(const PooledString& aNother) const { return mValue != aNother.mValue; }
+
+     private:
+        const std::string* mValue = nullptr;
+
+        inline static const std::string& empty_string() { static const std::string empty; return empty; }
+
+    }; // class PooledString
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs_chart_internal
+{
+      // Interned strings: each distinct string gets a small integer id (in the order of insertion)
+    class StringTable
+    {
+     public:
+        using Id = uint32_t;
+
+        inline Id insert(std::string aValue)
+            {
+                const auto [pos, inserted] = mIds.emplace(aValue, static_cast<Id>(mValues.size()));
+                if (inserted)
+                    mValues.push_back(aValue);
+                return pos->second;
+            }
+
+        inline std::optional<Id> find(std::string aValue) const
+            {
+                if (const auto found = mIds.find(aValue); found != mIds.end())
+                    return found->second;
+                else
+                    return {};
+            }
+
+        inline const std::string& operator[](Id aId) const { return mValues[aId]; }
+        inline size_t size() const { return mValues.size(); }
+        inline bool empty() const { return mValues.empty(); }
+        inline auto begin() const { return mValues.begin(); }
+        inline auto end() const { return mValues.end(); }
+
+     private:
+        std::vector<std::string> mValues;
+        std::unordered_map<std::string, Id> mIds;
+
+    }; // class StringTable
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
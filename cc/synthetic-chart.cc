@@ -0,0 +1,203 @@
+#include <random>
+#include <memory>
+
+#include "synthetic-chart.hh"
+#include "chart.hh"
+#include "merge.hh"
+
+// ----------------------------------------------------------------------
+
+  // Output of std::mt19937_64 is fixed by the standard, output of distributions is not,
+  // therefore numbers are derived from the engine output directly.
+class SyntheticRandom
+{
+ public:
+    inline SyntheticRandom(uint64_t aSeed) : mEngine(aSeed) {}
+
+    inline size_t below(size_t aBound) { return static_cast<size_t>(mEngine() % aBound); }
+    inline double uniform() { return static_cast<double>(mEngine() >> 11) * 0x1.0p-53; } // [0, 1)
+    inline bool chance(double aProbability) { return uniform() < aProbability; }
+    template <typename T, size_t N> inline const T& pick(const T (&aChoices)[N]) { return aChoices[below(N)]; }
+
+ private:
+    std::mt19937_64 mEngine;
+
+}; // class SyntheticRandom
+
+// ----------------------------------------------------------------------
+
+static const char* const sLocations[] = {
+    "SINGAPORE", "HONG KONG", "TOKYO", "BANGKOK", "VICTORIA", "PERTH", "BRISBANE", "TEXAS", "CALIFORNIA", "NEW YORK",
+    "ONTARIO", "SANTIAGO", "SAO PAULO", "CAPE TOWN", "NAIROBI", "BERLIN", "STOCKHOLM", "MOSCOW", "MADRID", "ENGLAND"
+};
+
+static const char* const sClades[] = {"3C.2A", "3C.2A1", "3C.3A"};
+
+template <typename Target> static inline void set(Target& aTarget, void (Target::*aSetter)(const char*, size_t), const std::string& aValue)
+{
+    (aTarget.*aSetter)(aValue.data(), aValue.size());
+}
+
+static inline std::string two_digits(size_t aValue)
+{
+    return (aValue < 10 ? "0" : "") + std::to_string(aValue);
+}
+
+  // mostly regular titers 10..5120, some thresholded
+static inline std::string make_titer(SyntheticRandom& aRandom, bool aHomologous)
+{
+    const size_t level = aHomologous ? 6 + aRandom.below(4) : aRandom.below(10);
+    if (level == 0)
+        return "<10";
+    if (level == 9 && aRandom.chance(0.5))
+        return ">5120";
+    return std::to_string(10 << level);
+}
+
+// ----------------------------------------------------------------------
+
+static void make_antigens_sera(Chart& aChart, const SyntheticChartParameters& aParameters, SyntheticRandom& aRandom)
+{
+    auto& antigens = aChart.antigens();
+    antigens.resize(aParameters.antigens);
+    for (size_t ag_no = 0; ag_no < antigens.size(); ++ag_no) {
+        auto& antigen = antigens[ag_no];
+        const std::string year = std::to_string(2010 + aRandom.below(8));
+        set(antigen, &Antigen::name, std::string{"A(H3N2)/"} + aRandom.pick(sLocations) + "/" + std::to_string(ag_no + 1) + "/" + year);
+        set(antigen, &Antigen::date, year + "-" + two_digits(1 + aRandom.below(12)) + "-" + two_digits(1 + aRandom.below(28)));
+        if (aRandom.chance(0.2)) {
+            set(antigen, &Antigen::passage, "E" + std::to_string(1 + aRandom.below(4)));
+            if (aRandom.chance(0.3))
+                set(antigen, &Antigen::reassortant, "NYMC X-" + std::to_string(100 + aRandom.below(200)));
+        }
+        else {
+            set(antigen, &Antigen::passage, (aRandom.chance(0.5) ? "MDCK" : "SIAT") + std::to_string(1 + aRandom.below(4)));
+        }
+        antigen.lab_id().push_back("CDC#" + year + std::to_string(100000 + ag_no));
+        antigen.clades().push_back(aRandom.pick(sClades));
+        if (ag_no < aParameters.sera)
+            set(antigen, &Antigen::semantic, "R");
+    }
+
+    auto& sera = aChart.sera();
+    sera.resize(std::min(aParameters.sera, aParameters.antigens));
+    for (size_t sr_no = 0; sr_no < sera.size(); ++sr_no) {
+        auto& serum = sera[sr_no];
+        const auto& antigen = antigens[sr_no];
+        set(serum, &Serum::name, antigen.name());
+        set(serum, &Serum::passage, antigen.passage());
+        set(serum, &Serum::reassortant, antigen.reassortant());
+        set(serum, &Serum::serum_id, "F" + std::to_string(1000 + sr_no));
+        set(serum, &Serum::serum_species, "FERRET");
+        if (aRandom.chance(0.1))
+            serum.annotations().push_back("BOOSTED");
+    }
+
+} // make_antigens_sera
+
+// ----------------------------------------------------------------------
+
+static void make_titers(Chart& aChart, const SyntheticChartParameters& aParameters, SyntheticRandom& aRandom)
+{
+    const size_t number_of_antigens = aChart.number_of_antigens(), number_of_sera = aChart.number_of_sera();
+    auto& titers = aChart.titers();
+    auto& layers = titers.layers();
+    layers.resize(aParameters.layers, ChartTiters::Dict(number_of_antigens));
+      // with layers each layer has a titer with the probability of density, merged titer is made of them
+    const double density = aParameters.layers ? aParameters.density / static_cast<double>(aParameters.layers) : aParameters.density;
+
+    if (aParameters.sparse)
+        titers.dict().resize(number_of_antigens);
+    else
+        titers.list().resize(number_of_antigens, std::vector<std::string>(number_of_sera, "*"));
+    std::vector<std::string> layer_titers;
+    for (size_t ag_no = 0; ag_no < number_of_antigens; ++ag_no) {
+        for (size_t sr_no = 0; sr_no < number_of_sera; ++sr_no) {
+            const bool homologous = ag_no == sr_no;
+            std::string titer;
+            if (layers.empty()) {
+                if (homologous || aRandom.chance(density))
+                    titer = make_titer(aRandom, homologous);
+            }
+            else {
+                layer_titers.clear();
+                for (auto& layer: layers) {
+                    if ((homologous && &layer == &layers.front()) || aRandom.chance(density)) {
+                        layer_titers.push_back(make_titer(aRandom, homologous));
+                        layer[ag_no].emplace_back(std::to_string(sr_no), layer_titers.back());
+                    }
+                }
+                if (!layer_titers.empty())
+                    titer = merge_titers(layer_titers);
+            }
+            if (!titer.empty()) {
+                if (aParameters.sparse)
+                    titers.dict()[ag_no].emplace_back(std::to_string(sr_no), titer);
+                else
+                    titers.list()[ag_no][sr_no] = titer;
+            }
+        }
+    }
+
+    auto& info = aChart.chart_info();
+    for (size_t layer_no = 0; layer_no < aParameters.layers; ++layer_no) {
+        ChartInfo source;
+        set(source, &ChartInfo::date, "2017" + two_digits(1 + layer_no % 12) + two_digits(1 + layer_no / 12 % 28));
+        set(source, &ChartInfo::lab, "CDC");
+        set(source, &ChartInfo::assay, "HI");
+        info.sources().push_back(source);
+    }
+
+} // make_titers
+
+// ----------------------------------------------------------------------
+
+static void make_projections(Chart& aChart, const SyntheticChartParameters& aParameters, SyntheticRandom& aRandom)
+{
+    auto& projections = aChart.projections();
+    projections.resize(aParameters.projections);
+    for (size_t projection_no = 0; projection_no < projections.size(); ++projection_no) {
+        auto& projection = projections[projection_no];
+        set(projection, &Projection::comment, "synthetic " + std::to_string(projection_no + 1));
+        set(projection, &Projection::minimum_column_basis, "none");
+        projection.stress(1000.0 + aRandom.uniform() * 1000.0);
+        auto& layout = projection.layout_for_json();
+        layout.resize(aChart.number_of_points(), std::vector<double>(aParameters.dimensions));
+        for (auto& coordinates: layout) {
+            for (auto& value: coordinates)
+                value = aRandom.uniform() * 10.0 - 5.0;
+        }
+    }
+
+} // make_projections
+
+// ----------------------------------------------------------------------
+
+Chart* make_synthetic_chart(const SyntheticChartParameters& aParameters)
+{
+    SyntheticRandom random(aParameters.seed);
+    auto chart = std::make_unique<Chart>();
+
+    auto& info = chart->chart_info();
+    set(info, &ChartInfo::virus, "INFLUENZA (ALL)");
+    set(info, &ChartInfo::virus_type, "A(H3N2)");
+    set(info, &ChartInfo::lab, "CDC");
+    set(info, &ChartInfo::assay, "HI");
+    set(info, &ChartInfo::rbc, "turkey");
+    set(info, &ChartInfo::name, aParameters.name);
+    if (!aParameters.layers)
+        set(info, &ChartInfo::date, "20170101");
+
+    make_antigens_sera(*chart, aParameters, random);
+    make_titers(*chart, aParameters, random);
+    make_projections(*chart, aParameters, random);
+    chart->plot_spec().reset(*chart);
+    chart->intern_annotations();
+    return chart.release();
+
+} // make_synthetic_chart
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
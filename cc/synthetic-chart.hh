@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+
+class Chart;
+
+  // Parameters of a synthetic chart for benchmarks. The same parameters (incl. seed)
+  // produce the same chart with any compiler and standard library.
+struct SyntheticChartParameters
+{
+    std::string name;
+    size_t antigens = 100;
+    size_t sera = 20;           // serum N is raised against reference antigen N, sera <= antigens
+    bool sparse = false;        // titers stored in the dict form ("d"), otherwise list ("l")
+    double density = 1.0;       // fraction of antigen/serum pairs having a titer
+    size_t layers = 0;          // the table is a merge of that many layers
+    size_t projections = 1;
+    size_t dimensions = 2;
+    uint64_t seed = 1;
+};
+
+Chart* make_synthetic_chart(const SyntheticChartParameters& aParameters);
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
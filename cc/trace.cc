@@ -0,0 +1,171 @@
+#include <vector>
+#include <mutex>
+#include <string_view>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "acmacs-base/read-file.hh"
+
+#include "trace.hh"
+
+// ----------------------------------------------------------------------
+
+static const char* const sCounterNames[] = {"titers_parsed", "cells_accessed", "name_matches", "locdb_lookups", "component_copies"};
+static_assert(sizeof(sCounterNames) / sizeof(sCounterNames[0]) == static_cast<size_t>(acmacs_chart_internal::Counter::Size_), "name required for each counter");
+
+std::atomic<bool> acmacs_chart_internal::sTraceEnabled{false};
+std::atomic<size_t> acmacs_chart_internal::sTraceCounters[static_cast<size_t>(acmacs_chart_internal::Counter::Size_)] = {};
+
+struct TraceEvent
+{
+    const char* name;
+    size_t thread;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration duration;
+};
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#pragma GCC diagnostic ignored "-Wglobal-constructors"
+#endif
+
+static std::mutex sTraceAccess;
+static std::vector<TraceEvent> sTraceEvents;
+static std::map<std::string_view, acmacs_chart_internal::TimerTotal> sTimerTotals; // keys are timer names (string literals)
+static const auto sTraceEpoch = std::chrono::steady_clock::now();
+
+  // ACMACS_CHART_TRACE=<file.json>: tracing is enabled at startup and the trace is written at exit
+static struct TraceFromEnvironment
+{
+    std::string filename;
+
+    inline TraceFromEnvironment()
+        {
+            if (const char* filename_env = std::getenv("ACMACS_CHART_TRACE"); filename_env && *filename_env) {
+                filename = filename_env;
+                acmacs_chart_internal::enable_trace();
+            }
+        }
+
+    inline ~TraceFromEnvironment()
+        {
+            if (!filename.empty()) {
+                try {
+                    acmacs_chart_internal::export_trace(filename);
+                }
+                catch (std::exception& err) {
+                    std::cerr << "ERROR: cannot write trace to " << filename << ": " << err.what() << std::endl;
+                }
+            }
+        }
+
+} sTraceFromEnvironment;
+
+#pragma GCC diagnostic pop
+
+// ----------------------------------------------------------------------
+
+static inline size_t thread_no()
+{
+    static std::atomic<size_t> next_thread_no{1};
+    thread_local const size_t no = next_thread_no.fetch_add(1);
+    return no;
+
+} // thread_no
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::record_timer(const char* aName, std::chrono::steady_clock::time_point aStart)
+{
+    const auto duration = std::chrono::steady_clock::now() - aStart;
+    const auto thread = thread_no();
+    std::lock_guard<std::mutex> lock{sTraceAccess};
+    if (sTraceEvents.size() < MaxTraceEvents)
+        sTraceEvents.push_back({aName, thread, aStart, duration});
+    auto& total = sTimerTotals[aName];
+    ++total.calls;
+    total.seconds += std::chrono::duration<double>(duration).count();
+
+} // acmacs_chart_internal::record_timer
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::enable_trace(bool aEnable)
+{
+    sTraceEnabled.store(aEnable, std::memory_order_relaxed);
+
+} // acmacs_chart_internal::enable_trace
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::reset_trace()
+{
+    std::lock_guard<std::mutex> lock{sTraceAccess};
+    for (auto& counter: sTraceCounters)
+        counter.store(0, std::memory_order_relaxed);
+    sTraceEvents.clear();
+    sTimerTotals.clear();
+
+} // acmacs_chart_internal::reset_trace
+
+// ----------------------------------------------------------------------
+
+std::map<std::string, size_t> acmacs_chart_internal::trace_counters()
+{
+    std::map<std::string, size_t> result;
+    for (size_t counter_no = 0; counter_no < static_cast<size_t>(Counter::Size_); ++counter_no)
+        result[sCounterNames[counter_no]] = sTraceCounters[counter_no].load(std::memory_order_relaxed);
+    return result;
+
+} // acmacs_chart_internal::trace_counters
+
+// ----------------------------------------------------------------------
+
+std::map<std::string, acmacs_chart_internal::TimerTotal> acmacs_chart_internal::trace_timers()
+{
+    std::lock_guard<std::mutex> lock{sTraceAccess};
+    return {sTimerTotals.begin(), sTimerTotals.end()};
+
+} // acmacs_chart_internal::trace_timers
+
+// ----------------------------------------------------------------------
+
+  // Trace Event Format, can be loaded into chrome://tracing or Perfetto UI
+std::string acmacs_chart_internal::trace_chrome_json()
+{
+    auto microseconds = [](auto aDuration) { return std::chrono::duration<double, std::micro>(aDuration).count(); };
+    const auto pid = getpid();
+    std::ostringstream output;
+    output.precision(15);
+    output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    {
+        std::lock_guard<std::mutex> lock{sTraceAccess};
+        for (const auto& event: sTraceEvents) {
+            output << "\n{\"name\": \"" << event.name << "\", \"cat\": \"acmacs-chart\", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << event.thread
+                   << ", \"ts\": " << microseconds(event.start - sTraceEpoch) << ", \"dur\": " << microseconds(event.duration) << "},";
+        }
+    }
+    output << "\n{\"name\": \"counters\", \"cat\": \"acmacs-chart\", \"ph\": \"C\", \"pid\": " << pid << ", \"tid\": 0, \"ts\": " << microseconds(std::chrono::steady_clock::now() - sTraceEpoch) << ", \"args\": {";
+    const auto counters = trace_counters();
+    for (auto counter = counters.begin(); counter != counters.end(); ++counter)
+        output << (counter == counters.begin() ? "" : ", ") << '"' << counter->first << "\": " << counter->second;
+    output << "}}\n]}\n";
+    return output.str();
+
+} // acmacs_chart_internal::trace_chrome_json
+
+// ----------------------------------------------------------------------
+
+void acmacs_chart_internal::export_trace(std::string aFilename)
+{
+    acmacs::file::write(aFilename, trace_chrome_json());
+
+} // acmacs_chart_internal::export_trace
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <atomic>
+#include <chrono>
+
+// ----------------------------------------------------------------------
+
+  // Runtime instrumentation of hot paths: scoped timers and counters.
+  // Disabled by default, then a timer or a counter costs one relaxed atomic load.
+  // Enabled by enable_trace() or by ACMACS_CHART_TRACE=<file.json> in the environment,
+  // in the latter case the trace is written to the file in Chrome trace format at exit.
+
+namespace acmacs_chart_internal
+{
+    enum class Counter : size_t { TitersParsed, CellsAccessed, NameMatches, LocDbLookups, ComponentCopies, Size_ };
+
+    extern std::atomic<bool> sTraceEnabled;
+    extern std::atomic<size_t> sTraceCounters[static_cast<size_t>(Counter::Size_)];
+
+    inline bool trace_enabled() { return sTraceEnabled.load(std::memory_order_relaxed); }
+
+    inline void count(Counter aCounter, size_t aIncrement = 1)
+    {
+        if (trace_enabled())
+            sTraceCounters[static_cast<size_t>(aCounter)].fetch_add(aIncrement, std::memory_order_relaxed);
+    }
+
+      // aName must be a string literal, it is kept until the trace is reset
+    void record_timer(const char* aName, std::chrono::steady_clock::time_point aStart);
+
+    class TraceTimer
+    {
+     public:
+        inline TraceTimer(const char* aName) : mName(trace_enabled() ? aName : nullptr) { if (mName) mStart = std::chrono::steady_clock::now(); }
+        inline ~TraceTimer() { if (mName) record_timer(mName, mStart); }
+        TraceTimer(const TraceTimer&) = delete;
+        TraceTimer& operator=(const TraceTimer&) = delete;
+
+     private:
+        const char* mName;
+        std::chrono::steady_clock::time_point mStart;
+
+    }; // class TraceTimer
+
+// ----------------------------------------------------------------------
+
+    struct TimerTotal
+    {
+        size_t calls = 0;
+        double seconds = 0.0;
+    };
+
+    void enable_trace(bool aEnable = true);
+      // clears counters, timer totals and recorded events
+    void reset_trace();
+
+    std::map<std::string, size_t> trace_counters();
+    std::map<std::string, TimerTotal> trace_timers();
+
+      // recorded timer events ("X") and final counter values ("C"), only the first MaxTraceEvents events are kept, totals are always updated
+    constexpr const size_t MaxTraceEvents = 1000000;
+    std::string trace_chrome_json();
+    void export_trace(std::string aFilename);
+
+} // namespace acmacs_chart_internal
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,887 @@
+// Checks of the library on synthetic charts and on test/test.ace.
+// Usage: acmacs-chart-test [--ace <test.ace>] [<test-name>...]
+// Exit code is the number of failed tests.
+
+#include <iostream>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <functional>
+#include <unistd.h>
+
+#include "synthetic-chart.hh"
+#include "chart.hh"
+#include "chart-view.hh"
+#include "ace.hh"
+#include "binary.hh"
+#include "merge.hh"
+#include "string-pool.hh"
+#include "parallel.hh"
+#include "trace.hh"
+
+namespace fs = std::filesystem;
+
+// ----------------------------------------------------------------------
+
+class TestFailed : public std::runtime_error { public: using std::runtime_error::runtime_error; };
+class TestSkipped : public std::runtime_error { public: using std::runtime_error::runtime_error; };
+
+#define CHECK(condition) do { if (!(condition)) throw TestFailed{std::string{"line "} + std::to_string(__LINE__) + ": " + #condition}; } while (false)
+#define CHECK_EQUAL(first, second) do { if (!((first) == (second))) throw TestFailed{std::string{"line "} + std::to_string(__LINE__) + ": " + #first + " == " + #second}; } while (false)
+
+static std::string sAceFilename;
+
+static inline std::unique_ptr<Chart> synthetic(size_t aAntigens, size_t aSera, bool aSparse, size_t aLayers, size_t aProjections, uint64_t aSeed = 1)
+{
+    SyntheticChartParameters parameters;
+    parameters.name = "test";
+    parameters.antigens = aAntigens;
+    parameters.sera = aSera;
+    parameters.sparse = aSparse;
+    parameters.density = aSparse ? 0.3 : 0.8;
+    parameters.layers = aLayers;
+    parameters.projections = aProjections;
+    parameters.seed = aSeed;
+    return std::unique_ptr<Chart>{make_synthetic_chart(parameters)};
+}
+
+static inline fs::path temp_filename(std::string aName)
+{
+    return fs::temp_directory_path() / ("acmacs-chart-test." + std::to_string(getpid()) + "." + aName);
+}
+
+  // antigens, sera, titers (incl. layers) and layouts of projections
+static void compare_charts(const Chart& aFirst, const Chart& aSecond)
+{
+    CHECK_EQUAL(aFirst.number_of_antigens(), aSecond.number_of_antigens());
+    CHECK_EQUAL(aFirst.number_of_sera(), aSecond.number_of_sera());
+    for (size_t ag_no = 0; ag_no < aFirst.number_of_antigens(); ++ag_no) {
+        CHECK_EQUAL(aFirst.antigens()[ag_no].full_name(), aSecond.antigens()[ag_no].full_name());
+        CHECK_EQUAL(aFirst.antigens()[ag_no].date(), aSecond.antigens()[ag_no].date());
+        CHECK(aFirst.antigens()[ag_no].lab_id() == aSecond.antigens()[ag_no].lab_id());
+        CHECK(aFirst.antigens()[ag_no].clades() == aSecond.antigens()[ag_no].clades());
+    }
+    for (size_t sr_no = 0; sr_no < aFirst.number_of_sera(); ++sr_no) {
+        CHECK_EQUAL(aFirst.sera()[sr_no].full_name(), aSecond.sera()[sr_no].full_name());
+        CHECK(aFirst.sera()[sr_no].homologous() == aSecond.sera()[sr_no].homologous());
+        for (size_t ag_no = 0; ag_no < aFirst.number_of_antigens(); ++ag_no)
+            CHECK_EQUAL(aFirst.titers().get(ag_no, sr_no), aSecond.titers().get(ag_no, sr_no));
+    }
+    CHECK(aFirst.titers().layers() == aSecond.titers().layers());
+    CHECK_EQUAL(aFirst.number_of_projections(), aSecond.number_of_projections());
+    for (size_t projection_no = 0; projection_no < aFirst.number_of_projections(); ++projection_no) {
+        const auto& first = aFirst.projection(projection_no).layout();
+        const auto& second = aSecond.projection(projection_no).layout();
+        CHECK_EQUAL(first.number_of_points(), second.number_of_points());
+        for (size_t point_no = 0; point_no < first.number_of_points(); ++point_no)
+            CHECK(first[point_no] == second[point_no]);
+    }
+    CHECK_EQUAL(aFirst.plot_spec().styles().size(), aSecond.plot_spec().styles().size());
+    CHECK(aFirst.plot_spec().style_for_point() == aSecond.plot_spec().style_for_point());
+}
+
+// ----------------------------------------------------------------------
+
+static void test_binary()
+{
+    for (const bool sparse: {false, true}) {
+        auto chart = synthetic(300, 40, sparse, sparse ? 4 : 0, 3);
+        chart->find_homologous_antigen_for_sera();
+        const auto data = export_chart_binary(*chart);
+        std::unique_ptr<Chart> imported{import_chart_binary(data)};
+        compare_charts(*chart, *imported);
+        CHECK(export_chart_binary(*imported) == data);
+
+        bool thrown = false;
+        try {
+            delete import_chart_binary(std::string_view(data.data(), data.size() - 1));
+        }
+        catch (BinaryChartReadError&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+// ----------------------------------------------------------------------
+
+static void test_ace_binary_ace()
+{
+    if (sAceFilename.empty())
+        throw TestSkipped{"--ace <test.ace> not given"};
+    std::unique_ptr<Chart> chart{import_chart(sAceFilename)};
+    std::unique_ptr<Chart> from_binary{import_chart_binary(export_chart_binary(*chart))};
+    compare_charts(*chart, *from_binary);
+    const auto filename = temp_filename("binary.ace");
+    export_chart(filename.string(), *from_binary);
+    std::unique_ptr<Chart> reimported{import_chart(filename.string())};
+    fs::remove(filename);
+    compare_charts(*chart, *reimported);
+}
+
+// ----------------------------------------------------------------------
+
+  // every other antigen in reverse order, sera in reverse order
+static void test_view_export()
+{
+    auto chart = synthetic(60, 20, true, 2, 2);
+    chart->find_homologous_antigen_for_sera();
+    ChartView::Indices antigens, sera;
+    for (size_t ag_no = chart->number_of_antigens(); ag_no > 0; ag_no -= 2)
+        antigens.push_back(ag_no - 2);
+    for (size_t sr_no = chart->number_of_sera(); sr_no > 0; --sr_no)
+        sera.push_back(sr_no - 1);
+    ChartView view(*chart, antigens, sera);
+
+    for (size_t sr_no = 0; sr_no < view.number_of_sera(); ++sr_no) {
+        ChartView::Indices expected;
+        for (auto ag_no: chart->sera()[sera[sr_no]].homologous()) {
+            if (const auto found = std::find(antigens.begin(), antigens.end(), ag_no); found != antigens.end())
+                expected.push_back(static_cast<size_t>(found - antigens.begin()));
+        }
+        CHECK(view.homologous(sr_no) == expected);
+    }
+    CHECK_EQUAL(view.homologous(view.number_of_sera() - 1), ChartView::Indices{view.number_of_antigens() - 1});
+
+    const auto filename = temp_filename("view.ace");
+    export_chart(filename.string(), view);
+    std::unique_ptr<Chart> imported{import_chart(filename.string())};
+    fs::remove(filename);
+    CHECK_EQUAL(imported->number_of_antigens(), view.number_of_antigens());
+    CHECK_EQUAL(imported->number_of_sera(), view.number_of_sera());
+    for (size_t ag_no = 0; ag_no < view.number_of_antigens(); ++ag_no)
+        CHECK_EQUAL(imported->antigens()[ag_no].full_name(), view.antigens()[ag_no].full_name());
+    for (size_t sr_no = 0; sr_no < view.number_of_sera(); ++sr_no) {
+        CHECK_EQUAL(imported->sera()[sr_no].full_name(), view.sera()[sr_no].full_name());
+        CHECK(imported->sera()[sr_no].homologous() == view.homologous(sr_no));
+        for (size_t ag_no = 0; ag_no < view.number_of_antigens(); ++ag_no)
+            CHECK_EQUAL(imported->titers().get(ag_no, sr_no), view.titers().get(ag_no, sr_no));
+    }
+    CHECK_EQUAL(imported->titers().layers().size(), chart->titers().layers().size());
+    CHECK_EQUAL(imported->number_of_projections(), view.number_of_projections());
+    for (size_t projection_no = 0; projection_no < view.number_of_projections(); ++projection_no) {
+        for (size_t point_no = 0; point_no < view.number_of_points(); ++point_no)
+            CHECK(imported->projection(projection_no).layout()[point_no] == view.projection(projection_no).layout()[point_no]);
+    }
+}
+
+// ----------------------------------------------------------------------
+
+  // each antigen and serum may be in the view once, every view point maps back to one parent point
+static void test_view_indices()
+{
+    auto chart = synthetic(20, 5, false, 0, 1);
+    const auto rejected = [&chart](const ChartView::Indices& aAntigens, const ChartView::Indices& aSera) -> bool {
+        try {
+            ChartView view(*chart, aAntigens, aSera);
+        }
+        catch (std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(!rejected({3, 1, 2}, {4, 0}));
+    CHECK(rejected({3, 1, 3}, {4, 0}));
+    CHECK(rejected({3, 1, 2}, {0, 4, 0}));
+
+    ChartView view(*chart, {3, 1, 2}, {4, 0});
+    CHECK(view.view_points({0, 1, 2, 3, 20, 24}) == (ChartView::Indices{1, 2, 0, 4, 3}));
+}
+
+// ----------------------------------------------------------------------
+
+static void test_copy_on_write()
+{
+    auto chart = synthetic(100, 10, false, 0, 2);
+    const std::string name = chart->antigens()[0].name();
+    const auto coordinates = chart->projection(1).layout()[5];
+    Chart copy(*chart);
+    copy.antigens()[0].name("COPY", 4);
+    copy.projection(1).layout().set(5, Coordinates{100.0, 100.0});
+    copy.titers().list()[0][0] = "12345";
+    CHECK_EQUAL(chart->antigens()[0].name(), name);
+    CHECK_EQUAL(copy.antigens()[0].name(), std::string{"COPY"});
+    CHECK(chart->projection(1).layout()[5] == coordinates);
+    CHECK(copy.projection(1).layout()[5] == (Coordinates{100.0, 100.0}));
+    CHECK(chart->titers().get(0, 0) != Titer{"12345"});
+    CHECK_EQUAL(copy.titers().get(0, 0), Titer{"12345"});
+    CHECK(copy.projection(0).layout()[0] == chart->projection(0).layout()[0]);
+}
+
+// ----------------------------------------------------------------------
+
+  // filter expressions against the same conditions checked entry by entry
+static void test_selection()
+{
+    auto chart = synthetic(500, 20, false, 0, 1);
+    const auto& antigens = chart->antigens();
+    using Filter = Antigens::Filter;
+    auto clade = [](const Antigen& aAntigen, std::string aClade) { return std::find(aAntigen.clades().begin(), aAntigen.clades().end(), aClade) != aAntigen.clades().end(); };
+    const std::vector<std::pair<Filter, std::function<bool (const Antigen&)>>> cases = {
+        {Filter::egg(), [](const Antigen& ag) { return ag.is_egg(); }},
+        {Filter::reference() & ~Filter::egg(), [](const Antigen& ag) { return ag.reference() && !ag.is_egg(); }},
+        {Filter::reassortant() | Filter::clade("3C.3A"), [&](const Antigen& ag) { return ag.is_reassortant() || clade(ag, "3C.3A"); }},
+        {~(Filter::cell() | Filter::test()), [](const Antigen& ag) { return (ag.is_egg() || ag.is_reassortant()) && ag.reference(); }},
+        {Filter::clade("3C.2A") & Antigens::date_range_filter("2012", "2015"), [&](const Antigen& ag) { return clade(ag, "3C.2A") && ag.date() >= "2012" && ag.date() < "2015"; }},
+        {Filter::indices({7, 3, 3, 499, 1000}) | Filter::clade("NONE"), [&](const Antigen& ag) { const auto no = static_cast<size_t>(&ag - &antigens[0]); return no == 3 || no == 7 || no == 499; }},
+    };
+    for (const auto& [filter, expected]: cases) {
+        const auto selection = antigens.select(filter);
+        for (size_t ag_no = 0; ag_no < antigens.size(); ++ag_no)
+            CHECK_EQUAL(selection.contains(ag_no), expected(antigens[ag_no]));
+        CHECK_EQUAL(selection.indices().size(), selection.count());
+        CHECK(antigens.select_if(expected).indices() == selection.indices());
+    }
+    const auto egg_in_2013 = antigens.select(Filter::egg()) & antigens.select_if([](const Antigen& ag) { return ag.date() >= "2013" && ag.date() < "2014"; });
+    CHECK(egg_in_2013.indices() == antigens.select(Filter::egg() & Antigens::date_range_filter("2013", "2014")).indices());
+}
+
+// ----------------------------------------------------------------------
+
+  // indices built before entries are edited in place must not be used after
+static void test_cache_invalidation()
+{
+    auto chart = synthetic(100, 10, false, 0, 0);
+    auto& antigens = chart->antigens();
+    const auto& const_antigens = antigens;
+    using Filter = Antigens::Filter;
+
+    const auto old_full_name = const_antigens[5].full_name();
+    CHECK_EQUAL(*const_antigens.find_by_full_name(old_full_name), size_t{5});
+    CHECK(const_antigens.find_by_name("RENAMED").empty());
+    Antigens::Indices lab_ids;
+    const_antigens.find_by_lab_id("TEST#1", lab_ids);
+    CHECK(lab_ids.empty());
+    CHECK(!const_antigens.select(Filter::clade("TEST-CLADE")).count());
+    CHECK(const_antigens.date_range_indices("2100-01-01", "2100-02-01").empty());
+    const size_t trigram_entries = const_antigens.name_trigram_index().number_of_names();
+
+    antigens[5].name() = "A(H3N2)/RENAMED/1/2017";
+    antigens[6].lab_id().push_back("TEST#1");
+    antigens[7].clades().push_back("TEST-CLADE");
+    for (auto& antigen: antigens) {
+        if (&antigen == &const_antigens[8])
+            antigen.date("2100-01-15", 10);
+    }
+
+    CHECK(!const_antigens.find_by_full_name(old_full_name));
+    CHECK_EQUAL(*const_antigens.find_by_full_name(const_antigens[5].full_name()), size_t{5});
+    CHECK(const_antigens.find_by_name("RENAMED") == Antigens::Indices{5});
+    const_antigens.find_by_lab_id("TEST#1", lab_ids);
+    CHECK(lab_ids == Antigens::Indices{6});
+    CHECK(const_antigens.select(Filter::clade("TEST-CLADE")).indices() == Antigens::Indices{7});
+    CHECK(const_antigens.date_range_indices("2100-01-01", "2100-02-01") == Antigens::Indices{8});
+    CHECK_EQUAL(const_antigens.name_trigram_index().number_of_names(), trigram_entries);
+    Antigens::Indices matching;
+    const_antigens.find_by_name_matching("A(H3N2)/RENAMED/1/2017", matching);
+    CHECK(!matching.empty() && matching.front() == 5);
+
+      // edits through a pointer kept since before the last query need explicit invalidation
+    auto* serum = &chart->sera()[0];
+    CHECK(chart->sera().find_by_name("RENAMED").empty());
+    serum->name() = "A(H3N2)/RENAMED/2/2017";
+    chart->sera().invalidate_caches();
+    CHECK(chart->sera().find_by_name("RENAMED") == Sera::Indices{0});
+}
+
+// ----------------------------------------------------------------------
+
+  // date index and string fallback agree with plain string comparison of dates for partial, invalid and empty dates and bounds
+static void test_date_range()
+{
+    const std::vector<std::string> dates{"", "2016", "2016-03", "2016-03-05", "2016-03-31", "2016-13-01", "20160305", "2016-3-5", "2015-12-31", "2017", "garbage", "2016-00", "2016-03-00", "2016-02-31"};
+    const std::vector<std::string> bounds{"", "2016", "2016-03", "2016-03-05", "2016-03-06", "2016-13", "20160305", "2016-3", "2017-01-01", "x"};
+    auto chart = synthetic(dates.size() * 3, 5, false, 0, 0);
+    auto& antigens = chart->antigens();
+    for (size_t ag_no = 0; ag_no < antigens.size(); ++ag_no)
+        antigens[ag_no].date(dates[ag_no % dates.size()].data(), dates[ag_no % dates.size()].size());
+    const auto& const_antigens = antigens;
+
+    for (const auto& first: bounds) {
+        for (const auto& after_last: bounds) {
+            Antigens::Indices expected;
+            for (size_t ag_no = 0; ag_no < const_antigens.size(); ++ag_no) {
+                const auto& date = dates[ag_no % dates.size()];
+                if (!date.empty() && (first.empty() || date >= first) && (after_last.empty() || date < after_last))
+                    expected.push_back(ag_no);
+            }
+            CHECK(const_antigens.date_range_indices(first, after_last) == expected);
+            CHECK(const_antigens.select(Antigens::date_range_filter(first, after_last)).indices() == expected);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------
+
+  // group index (continent, lineage, passage type, reference) follows in-place edits
+static void test_selection_after_edit()
+{
+    auto chart = synthetic(50, 5, false, 0, 0);
+    auto& antigens = chart->antigens();
+    const auto& const_antigens = antigens;
+    using Filter = Antigens::Filter;
+
+    antigens[3].name() = "A(H3N2)/LONDON/3/2017";
+    CHECK(const_antigens.select(Filter::continent("EUROPE")).contains(3));
+    CHECK(!const_antigens.select(Filter::continent("ASIA")).contains(3));
+    antigens[3].name() = "A(H3N2)/TOKYO/3/2017";
+    CHECK(!const_antigens.select(Filter::continent("EUROPE")).contains(3));
+    CHECK(const_antigens.select(Filter::continent("ASIA") & Filter::country("JAPAN")).contains(3));
+
+    antigens[4].lineage("VICTORIA", 8);
+    CHECK(const_antigens.select(Filter::lineage("VICTORIA")).indices() == Antigens::Indices{4});
+    antigens[4].lineage("YAMAGATA", 8);
+    CHECK(const_antigens.select(Filter::lineage("VICTORIA")).indices().empty());
+
+    antigens[10].passage() = "E4";
+    antigens[10].reassortant("", 0);
+    CHECK(const_antigens.select(Filter::egg()).contains(10));
+    antigens[10].passage() = "MDCK2";
+    CHECK(!const_antigens.select(Filter::egg()).contains(10));
+
+    antigens[11].semantic("R", 1);
+    CHECK(const_antigens.select(Filter::reference()).contains(11));
+    antigens[11].semantic("", 0);
+    CHECK(const_antigens.select(Filter::test()).contains(11));
+}
+
+// ----------------------------------------------------------------------
+
+static void test_merge()
+{
+    CHECK_EQUAL(merge_titers({"40", "40"}), std::string{"40"});
+    CHECK_EQUAL(merge_titers({"<10", "<20"}), std::string{"<10"});
+    CHECK_EQUAL(merge_titers({">1280", ">5120"}), std::string{">5120"});
+    CHECK_EQUAL(merge_titers({"<10", ">1280"}), std::string{"*"});
+    CHECK_EQUAL(merge_titers({"40", "1280"}), std::string{"*"});
+    CHECK_EQUAL(merge_titers({"40", "160"}), std::string{"80"});
+
+    auto chart = synthetic(200, 20, true, 0, 0);
+    auto another = synthetic(200, 20, true, 0, 0, 2);
+    std::unique_ptr<Chart> merged{merge_charts({chart.get(), chart.get()})};
+    CHECK_EQUAL(merged->number_of_antigens(), chart->number_of_antigens());
+    CHECK_EQUAL(merged->number_of_sera(), chart->number_of_sera());
+    CHECK_EQUAL(merged->titers().layers().size(), size_t{2});
+    CHECK_EQUAL(merged->chart_info().sources().size(), size_t{2});
+    for (size_t ag_no = 0; ag_no < chart->number_of_antigens(); ++ag_no) {
+        CHECK_EQUAL(merged->antigens()[ag_no].full_name(), chart->antigens()[ag_no].full_name());
+        for (size_t sr_no = 0; sr_no < chart->number_of_sera(); ++sr_no)
+            CHECK_EQUAL(merged->titers().get(ag_no, sr_no), chart->titers().get(ag_no, sr_no));
+    }
+
+      // antigens of both charts, each found once
+    std::unique_ptr<Chart> union_chart{merge_charts({chart.get(), another.get()})};
+    const auto in_first = union_chart->match_antigens(*chart), in_second = union_chart->match_antigens(*another);
+    for (size_t ag_no = 0; ag_no < union_chart->number_of_antigens(); ++ag_no)
+        CHECK(in_first.mapping[ag_no] != AntigenSerumNotFound || in_second.mapping[ag_no] != AntigenSerumNotFound);
+    CHECK(chart->match_antigens(*union_chart).not_found.empty());
+    CHECK(another->match_antigens(*union_chart).not_found.empty());
+      // layer of the first source has no rows for antigens found in the second source only
+    CHECK(union_chart->titers().layers()[0].size() <= chart->number_of_antigens());
+    for (size_t ag_no = 0; ag_no < chart->number_of_antigens(); ++ag_no) {
+        for (size_t sr_no = 0; sr_no < chart->number_of_sera(); ++sr_no) {
+            if (const auto& titer = chart->titers().get(ag_no, sr_no); !titer.empty() && titer.front() != '*')
+                CHECK(!union_chart->titers().layers()[0][ag_no].empty());
+        }
+    }
+
+      // the same antigens with different passages
+    auto repassaged = synthetic(200, 20, true, 0, 0);
+    for (auto& antigen: repassaged->antigens())
+        antigen.passage() += "X";
+    std::unique_ptr<Chart> strict{merge_charts({chart.get(), repassaged.get()})};
+    CHECK_EQUAL(strict->number_of_antigens(), chart->number_of_antigens() * 2);
+    std::unique_ptr<Chart> ignore_passage{merge_charts({chart.get(), repassaged.get()}, MergeMatch::IgnorePassage)};
+    CHECK_EQUAL(ignore_passage->number_of_antigens(), chart->number_of_antigens());
+    CHECK_EQUAL(ignore_passage->number_of_sera(), chart->number_of_sera());
+
+      // incompatible sources
+    auto focus = synthetic(200, 20, true, 0, 0);
+    focus->chart_info().assay_ref() = "FOCUS REDUCTION";
+    bool thrown = false;
+    try {
+        std::unique_ptr<Chart> incompatible{merge_charts({chart.get(), focus.get()})};
+    }
+    catch (MergeError&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// ----------------------------------------------------------------------
+
+  // fields merged over sources and the source index are recomputed after setters, *_ref() and sources() edits
+static void test_chart_info()
+{
+    const auto make_source = [](std::string aDate, std::string aLab, std::string aAssay) -> ChartInfo {
+        ChartInfo source;
+        source.virus_type("A(H3N2)", 7);
+        source.date(aDate.data(), aDate.size());
+        source.lab(aLab.data(), aLab.size());
+        source.assay(aAssay.data(), aAssay.size());
+        return source;
+    };
+
+    ChartInfo info;
+    info.sources().push_back(make_source("20170101", "CDC", "HI"));
+    info.sources().push_back(make_source("20170301", "NIMR", "HI"));
+    info.sources().push_back(make_source("20170201", "CDC", "FOCUS REDUCTION"));
+    CHECK_EQUAL(info.virus_type(), std::string{"A(H3N2)"});
+    CHECK_EQUAL(info.date(), std::string{"20170101-20170301"});
+    CHECK_EQUAL(info.lab(), std::string{"CDC+NIMR"});
+    CHECK(info.make_name().find("CDC+NIMR") != std::string::npos);
+    CHECK(info.sources_by_lab("CDC") == (ChartInfo::Indices{0, 2}));
+    CHECK(info.sources_by_assay("FOCUS REDUCTION") == (ChartInfo::Indices{2}));
+    CHECK(info.sources_by_date("20170201") == (ChartInfo::Indices{2}));
+    CHECK(info.sources_by_date("2017").empty());
+    CHECK(info.sources_in_date_range("20170115", "20170301") == (ChartInfo::Indices{2}));
+    CHECK(info.sources_in_date_range("", "20170201") == (ChartInfo::Indices{0}));
+    CHECK(info.sources_in_date_range("20170201", "") == (ChartInfo::Indices{1, 2}));
+    CHECK(info.sources_in_date_range("", "") == (ChartInfo::Indices{0, 1, 2}));
+    CHECK(info.sources_in_date_range("20180101", "").empty());
+
+      // sources() edits: field of a source, the same number of sources
+    info.sources()[1].lab_ref() = "CDC";
+    CHECK_EQUAL(info.lab(), std::string{"CDC"});
+    CHECK(info.make_name().find("NIMR") == std::string::npos);
+    CHECK(info.sources_by_lab("NIMR").empty());
+    CHECK(info.sources_by_lab("CDC") == (ChartInfo::Indices{0, 1, 2}));
+    info.sources()[2].date("20170401", 8);
+    CHECK_EQUAL(info.date(), std::string{"20170101-20170401"});
+    CHECK(info.sources_in_date_range("20170115", "20170301").empty());
+    info.sources().push_back(make_source("20160101", "MELB", "HI"));
+    CHECK_EQUAL(info.date(), std::string{"20160101-20170401"});
+    CHECK(info.sources_in_date_range("", "20170101") == (ChartInfo::Indices{3}));
+    CHECK(info.sources_by_lab("MELB") == (ChartInfo::Indices{3}));
+
+      // own fields take precedence over sources
+    info.virus_ref() = "INFLUENZA";
+    CHECK_EQUAL(info.virus(), std::string{"INFLUENZA"});
+    info.lab("VIDRL", 5);
+    CHECK_EQUAL(info.lab(), std::string{"VIDRL"});
+    info.date_ref() = "2018";
+    CHECK_EQUAL(info.date(), std::string{"2018"});
+    CHECK(info.make_name().find("VIDRL") != std::string::npos);
+    CHECK(info.make_name().find("2018") != std::string::npos);
+    info.name("TABLE", 5);
+    CHECK_EQUAL(info.make_name(), std::string{"TABLE"});
+    info.name_ref().clear();
+    CHECK(info.make_name().find("VIDRL") != std::string::npos);
+}
+
+// ----------------------------------------------------------------------
+
+  // list and dict forms and layers in numeric form, incl. thresholded, dont-care and garbage titers and short rows
+static void test_titers_numeric()
+{
+    constexpr const size_t antigens = 3, sera = 4;
+    std::vector<double> values(antigens * sera);
+    std::vector<ChartTiters::TiterType> types(antigens * sera);
+    const auto check = [&values, &types](size_t aCell, ChartTiters::TiterType aType, double aValue) {
+        CHECK_EQUAL(types[aCell], aType);
+        if (aType == ChartTiters::DontCare)
+            CHECK(std::isnan(values[aCell]));
+        else
+            CHECK_EQUAL(values[aCell], aValue);
+    };
+
+    ChartTiters list;
+    list.list() = {{"10", "<20", ">1280", "*"}, {"40x", "", "abc", "<"}, {"0", "-5", "80"}};
+    list.numeric(antigens, sera, values.data(), types.data());
+    check(0, ChartTiters::Regular, 0.0);
+    check(1, ChartTiters::LessThan, 1.0);
+    check(2, ChartTiters::MoreThan, 7.0);
+    for (size_t cell = 3; cell < 10; ++cell)
+        check(cell, ChartTiters::DontCare, 0.0);
+    check(10, ChartTiters::Regular, 3.0);
+    check(11, ChartTiters::DontCare, 0.0); // row shorter than the number of sera
+
+    ChartTiters dict;
+    dict.dict() = {{{"0", "10"}, {"3", "<20"}}, {{"1", ">1280"}, {"x", "40"}, {"4", "40"}, {"2", "?"}}, {}};
+    dict.numeric(antigens, sera, values.data(), types.data());
+    check(0, ChartTiters::Regular, 0.0);
+    check(3, ChartTiters::LessThan, 1.0);
+    check(5, ChartTiters::MoreThan, 7.0);
+    for (size_t cell: {1, 2, 4, 6, 7, 8, 9, 10, 11})
+        check(cell, ChartTiters::DontCare, 0.0);
+
+      // layer trimmed by merge: no rows for antigens found in other sources only
+    dict.layers() = {{{{"2", "160"}}}, {}};
+    dict.numeric(antigens, sera, values.data(), types.data(), 0);
+    check(2, ChartTiters::Regular, 4.0);
+    for (size_t cell = 0; cell < antigens * sera; ++cell) {
+        if (cell != 2)
+            check(cell, ChartTiters::DontCare, 0.0);
+    }
+    dict.numeric(antigens, sera, values.data(), types.data(), 1);
+    for (size_t cell = 0; cell < antigens * sera; ++cell)
+        check(cell, ChartTiters::DontCare, 0.0);
+
+      // titers of a synthetic chart with layers agree with Titer
+    auto chart = synthetic(100, 10, true, 2, 0);
+    const auto& titers = chart->titers();
+    values.resize(chart->number_of_antigens() * chart->number_of_sera());
+    types.resize(values.size());
+    titers.numeric(chart->number_of_antigens(), chart->number_of_sera(), values.data(), types.data());
+    for (size_t ag_no = 0; ag_no < chart->number_of_antigens(); ++ag_no) {
+        for (size_t sr_no = 0; sr_no < chart->number_of_sera(); ++sr_no) {
+            const auto titer = titers.get(ag_no, sr_no);
+            const size_t cell = ag_no * chart->number_of_sera() + sr_no;
+            if (titer.is_dont_care())
+                check(cell, ChartTiters::DontCare, 0.0);
+            else
+                check(cell, titer.is_less_than() ? ChartTiters::LessThan : (titer.is_more_than() ? ChartTiters::MoreThan : ChartTiters::Regular), titer.similarity());
+        }
+    }
+}
+
+// ----------------------------------------------------------------------
+
+  // indexed searches against linear scans over entries
+static void test_find_by_name()
+{
+    auto chart = synthetic(2000, 50, false, 0, 0);
+    const auto& antigens = chart->antigens();
+    std::mt19937 random{1};
+    std::vector<std::string> queries{"", "A", "/", "SINGAPORE", "NOT-THERE", "A(H3N2)/TEXAS/1"};
+    for (size_t query_no = 0; query_no < 200; ++query_no) {
+        const auto name = antigens[random() % antigens.size()].name();
+        const auto first = random() % name.size();
+        queries.push_back(name.substr(first, 1 + random() % (name.size() - first)));
+    }
+    for (const auto& query: queries) {
+        Antigens::Indices expected;
+        for (size_t ag_no = 0; ag_no < antigens.size(); ++ag_no) {
+            if (antigens[ag_no].name().find(query) != std::string::npos)
+                expected.push_back(ag_no);
+        }
+        CHECK(antigens.find_by_name(query) == expected);
+    }
+
+    for (size_t ag_no = 0; ag_no < antigens.size(); ag_no += 37) {
+        const auto full_name = antigens[ag_no].full_name();
+        size_t expected = 0;
+        while (antigens[expected].full_name() != full_name)
+            ++expected;
+        CHECK_EQUAL(*antigens.find_by_full_name(full_name), expected);
+    }
+    CHECK(!antigens.find_by_full_name("NOT-THERE"));
+}
+
+// ----------------------------------------------------------------------
+
+  // find_by_name_matching without the trigram index: every entry scored, entries with the best name score ranked by full name score
+static Antigens::Indices find_by_name_matching_exhaustive(const Antigens& aAntigens, std::string aName, string_match::score_t aScoreThreshold)
+{
+    string_match::score_t score_threshold = aScoreThreshold;
+    for (const auto& antigen: aAntigens)
+        score_threshold = std::max(string_match::match(antigen.name(), aName), score_threshold);
+    std::vector<std::pair<size_t, string_match::score_t>> index_score;
+    for (size_t ag_no = 0; ag_no < aAntigens.size(); ++ag_no) {
+        AntigenSerumMatchScore<Antigen> score{aName, aAntigens[ag_no], score_threshold};
+        if (score.full_name_score())
+            index_score.emplace_back(ag_no, score.full_name_score());
+    }
+    std::stable_sort(index_score.begin(), index_score.end(), [](const auto& a, const auto& b) -> bool { return a.second > b.second; });
+    Antigens::Indices result;
+    for (const auto& is: index_score) {
+        if (is.second < index_score.front().second)
+            break;
+        if (! ((aName.find("CELL") != std::string::npos && aAntigens[is.first].is_egg()) || (aName.find("EGG") != std::string::npos && !aAntigens[is.first].is_egg()) || (aName.find("WILDTYPE") != std::string::npos && aAntigens[is.first].is_reassortant())))
+            result.push_back(is.first);
+    }
+    return result;
+}
+
+static void test_find_by_name_matching()
+{
+    auto chart = synthetic(500, 20, false, 0, 0);
+    const auto& antigens = chart->antigens();
+    std::mt19937 random{2};
+      // short names and names sharing no trigram with any antigen are matched by 1-2 char overlaps
+    std::vector<std::string> queries{"A", "AB", "A(X", "A(H3", "XA/ZZ", "QQQQQQ", "A(H3N2)/"};
+    for (size_t query_no = 0; query_no < 100; ++query_no) {
+        const auto& antigen = antigens[random() % antigens.size()];
+        switch (query_no % 4) {
+          case 0:
+              queries.push_back(antigen.name());
+              break;
+          case 1:
+              queries.push_back(antigen.full_name());
+              break;
+          case 2:
+              queries.push_back(antigen.name() + (antigen.is_egg() ? " EGG" : " CELL"));
+              break;
+          case 3: {
+              const auto& name = antigen.name();
+              const auto first = random() % name.size();
+              queries.push_back(name.substr(first, 1 + random() % std::min(name.size() - first, size_t{8})));
+          }
+              break;
+        }
+    }
+    for (const auto& query: queries) {
+        for (string_match::score_t threshold: {0, 2, 50}) {
+            Antigens::Indices found;
+            antigens.find_by_name_matching(query, found, threshold);
+            std::sort(found.begin(), found.end());
+            auto expected = find_by_name_matching_exhaustive(antigens, query, threshold);
+            std::sort(expected.begin(), expected.end());
+            if (found != expected)
+                throw TestFailed{"find_by_name_matching \"" + query + "\" threshold " + std::to_string(threshold) + ": " + std::to_string(found.size()) + " found, " + std::to_string(expected.size()) + " expected"};
+        }
+    }
+    const auto found_many = antigens.find_by_name_matching(queries);
+    for (size_t query_no = 0; query_no < queries.size(); ++query_no) {
+        Antigens::Indices found;
+        antigens.find_by_name_matching(queries[query_no], found);
+        CHECK(found_many[query_no] == found);
+    }
+
+      // full virus names: only a small fraction of names is scored
+    auto big = synthetic(5000, 20, false, 0, 0);
+    const auto& big_antigens = big->antigens();
+    big_antigens.name_trigram_index();
+    acmacs_chart_internal::enable_trace();
+    for (size_t ag_no: {size_t{17}, size_t{1234}, size_t{4999}}) {
+        const auto name = big_antigens[ag_no].name();
+        acmacs_chart_internal::reset_trace();
+        Antigens::Indices found;
+        big_antigens.find_by_name_matching(name, found);
+        const auto scored = acmacs_chart_internal::trace_counters().at("name_matches");
+        CHECK(scored * 20 < big_antigens.size());
+        CHECK(std::find(found.begin(), found.end(), ag_no) != found.end());
+        auto expected = find_by_name_matching_exhaustive(big_antigens, name, 0);
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK(found == expected);
+    }
+    acmacs_chart_internal::enable_trace(false);
+    acmacs_chart_internal::reset_trace();
+}
+
+// ----------------------------------------------------------------------
+
+static inline Annotations make_annotations(std::initializer_list<const char*> aValues)
+{
+    Annotations annotations;
+    annotations.insert(annotations.end(), aValues.begin(), aValues.end());
+    return annotations;
+}
+
+  // sets compare regardless of order: by id within a table, sorted across tables and when not interned
+static void test_annotations()
+{
+    AnnotationsTable table, another_table;
+    auto ab = make_annotations({"B", "A"}), ba = make_annotations({"A", "B"}), ac = make_annotations({"A", "C"});
+    const auto not_interned = make_annotations({"B", "A"});
+    table.intern(ab);
+    table.intern(ba);
+    table.intern(ac);
+    CHECK(ab.interned() && ba.interned() && ac.interned());
+    CHECK_EQUAL(ab.id(), ba.id());
+    CHECK(ab.id() != ac.id());
+    CHECK(ab == ba);
+    CHECK(ab != ac);
+    CHECK_EQUAL(table.size(), size_t{2});
+
+    auto ba_another = make_annotations({"A", "B"}), ca_another = make_annotations({"C", "A"});
+    another_table.intern(ba_another);
+    another_table.intern(ca_another);
+    CHECK(ab.table_id() != ba_another.table_id());
+    CHECK(ab == ba_another);
+    CHECK(ba_another == ab);
+    CHECK(ab != ca_another);
+    CHECK(ac == ca_another);
+    CHECK(ab == not_interned);
+    CHECK(not_interned == ab);
+    CHECK(not_interned != ac);
+
+      // distinct() of interned and not interned sets
+    auto distinct = make_annotations({"DISTINCT"});
+    CHECK(distinct.distinct());
+    table.intern(distinct);
+    CHECK(distinct.distinct());
+    CHECK(!ab.distinct());
+
+      // non-const annotations() drops the id: a stale id would compare {A,C} unequal to {A,C}
+    Antigen antigen, another;
+    antigen.name() = another.name() = "A(H3N2)/TEXAS/50/2012";
+    antigen.annotations() = make_annotations({"A", "B"});
+    another.annotations() = make_annotations({"A", "C"});
+    table.intern(antigen.annotations());
+    table.intern(another.annotations());
+    const Antigen& const_antigen = antigen;
+    CHECK(const_antigen.annotations().interned());
+    CHECK(const_antigen.annotations() != another.annotations());
+    antigen.annotations()[1] = "C";
+    CHECK(!const_antigen.annotations().interned());
+    CHECK(const_antigen.annotations() == another.annotations());
+    CHECK(antigen.match(another) == another.match(antigen));
+    CHECK(antigen.match(another) < AntigenSerumMatch::AnnotationMismatch);
+    antigen.annotations() = distinct;
+    CHECK(const_antigen.annotations().interned());
+    antigen.annotations().clear();
+    CHECK(!const_antigen.annotations().distinct());
+
+      // serum specific annotations (CONC, BOOSTED, BLEED) of the serum are ignored, those of the antigen are not
+    const auto serum_annotation_match = [](Annotations aSerum, Annotations aAntigen, bool aInterned) -> bool {
+        Serum serum;
+        Antigen antigen;
+        serum.name() = antigen.name() = "A(H3N2)/TEXAS/50/2012";
+        serum.annotations() = aSerum;
+        antigen.annotations() = aAntigen;
+        if (aInterned) {
+            AnnotationsTable annotations_table;
+            annotations_table.intern(serum.annotations());
+            annotations_table.intern(antigen.annotations());
+        }
+        CHECK(serum.match(antigen) == antigen.match(serum));
+        return serum.match(antigen) < AntigenSerumMatch::AnnotationMismatch;
+    };
+    for (bool interned: {false, true}) {
+        CHECK(serum_annotation_match(make_annotations({"CONC 2:1"}), make_annotations({}), interned));
+        CHECK(serum_annotation_match(make_annotations({"BOOSTED 1", "2009-05-12"}), make_annotations({"2009-05-12"}), interned));
+        CHECK(serum_annotation_match(make_annotations({"2ND BLEED", "CONC 4:1", "NIMR ISOLATE 1"}), make_annotations({"NIMR ISOLATE 1"}), interned));
+        CHECK(!serum_annotation_match(make_annotations({"CONC 2:1", "NIMR ISOLATE 1"}), make_annotations({}), interned));
+        CHECK(!serum_annotation_match(make_annotations({"CONC 2:1"}), make_annotations({"CONC 2:1"}), interned));
+        CHECK(!serum_annotation_match(make_annotations({}), make_annotations({"2ND BLEED"}), interned));
+        CHECK(serum_annotation_match(make_annotations({}), make_annotations({}), interned));
+    }
+}
+
+// ----------------------------------------------------------------------
+
+  // equal values interned concurrently from many threads are the same object
+static void test_string_pool()
+{
+    using namespace acmacs_chart_internal;
+    std::vector<std::string> values(1000);
+    for (size_t no = 0; no < values.size(); ++no)
+        values[no] = "string-pool-test-" + std::to_string(no);
+    std::vector<const std::string*> first(values.size()), second(values.size());
+    parallel_for(values.size(), [&](size_t no) { first[no] = StringPool::intern(values[no]); }, 1);
+    parallel_for(values.size(), [&](size_t no) { second[no] = StringPool::intern(values[values.size() - no - 1]); }, 1);
+    for (size_t no = 0; no < values.size(); ++no) {
+        CHECK_EQUAL(*first[no], values[no]);
+        CHECK_EQUAL(first[no], second[values.size() - no - 1]);
+    }
+    CHECK(PooledString{"string-pool-test-1"} == PooledString{values[1]});
+    CHECK(PooledString{"string-pool-test-1"} != PooledString{values[2]});
+    CHECK(PooledString{""}.empty());
+}
+
+// ----------------------------------------------------------------------
+
+  // per entry abbreviations agree with the indexed ones, locations missing in locdb give empty string, from many threads
+static void test_location_abbreviated()
+{
+    auto chart = synthetic(500, 20, false, 0, 0);
+    const auto& antigens = chart->antigens();
+    std::vector<std::string> abbreviated(antigens.size());
+    acmacs_chart_internal::parallel_for(antigens.size(), [&](size_t ag_no) { abbreviated[ag_no] = antigens[ag_no].location_abbreviated(); }, 1);
+    for (size_t ag_no = 0; ag_no < antigens.size(); ++ag_no) {
+        CHECK_EQUAL(abbreviated[ag_no], antigens.location_abbreviated(ag_no));
+        CHECK(!antigens[ag_no].name_abbreviated().empty());
+    }
+}
+
+// ----------------------------------------------------------------------
+
+  // per projection components, total is the sum of all components except the shared string pool
+static void test_memory_usage()
+{
+    auto chart = synthetic(100, 10, false, 0, 2);
+    const auto usage = chart->memory_usage();
+    for (const auto* component: {"projections[0].layout", "projections[1].layout", "projections[1].column_bases", "projections[1].titer_multipliers", "projections[1].gradient_multipliers"})
+        CHECK(usage.count(component) == 1);
+    CHECK(usage.at("projections[0].layout") >= chart->number_of_points() * sizeof(double));
+    size_t total = 0;
+    for (const auto& [component, bytes]: usage) {
+        if (component != "total" && component != "string_pool")
+            total += bytes;
+    }
+    CHECK_EQUAL(usage.at("total"), total);
+}
+
+// ----------------------------------------------------------------------
+
+  // equal styles are shared, replacing a style keeps the index consistent
+static void test_plot_spec_styles()
+{
+    ChartPlotSpec plot_spec;
+    plot_spec.style_for_point().resize(10, 0);
+    plot_spec.styles({ChartPlotSpecStyle{}});
+    const ChartPlotSpecStyle red("red", "black", ChartPlotSpecStyle::Circle, 1), blue("blue", "black", ChartPlotSpecStyle::Box, 1);
+    plot_spec.set({1, 2}, red);
+    plot_spec.set(3, red);
+    CHECK_EQUAL(plot_spec.styles().size(), size_t{2});
+    CHECK_EQUAL(plot_spec.style_for_point()[3], plot_spec.style_for_point()[1]);
+
+    plot_spec.style(plot_spec.style_for_point()[1], blue);
+    CHECK(plot_spec.style_for(2) == blue);
+    CHECK_EQUAL(plot_spec.add_style(blue), plot_spec.style_for_point()[1]);
+    plot_spec.set(4, red);
+    CHECK_EQUAL(plot_spec.styles().size(), size_t{3});
+    CHECK(plot_spec.style_for(4) == red);
+    CHECK_EQUAL(plot_spec.add_style(ChartPlotSpecStyle{}), size_t{0});
+}
+
+// ----------------------------------------------------------------------
+
+static const std::vector<std::pair<std::string, void (*)()>> sTests = {
+    {"binary", test_binary},
+    {"ace-binary-ace", test_ace_binary_ace},
+    {"view-indices", test_view_indices},
+    {"view-export", test_view_export},
+    {"copy-on-write", test_copy_on_write},
+    {"selection", test_selection},
+    {"cache-invalidation", test_cache_invalidation},
+    {"date-range", test_date_range},
+    {"selection-after-edit", test_selection_after_edit},
+    {"merge", test_merge},
+    {"chart-info", test_chart_info},
+    {"titers-numeric", test_titers_numeric},
+    {"find-by-name", test_find_by_name},
+    {"find-by-name-matching", test_find_by_name_matching},
+    {"annotations", test_annotations},
+    {"string-pool", test_string_pool},
+    {"location-abbreviated", test_location_abbreviated},
+    {"memory-usage", test_memory_usage},
+    {"plot-spec-styles", test_plot_spec_styles},
+};
+
+int main(int argc, char* const argv[])
+{
+    std::vector<std::string> names;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::string{argv[arg]} == "--ace" && arg + 1 < argc)
+            sAceFilename = argv[++arg];
+        else
+            names.push_back(argv[arg]);
+    }
+
+    int failed = 0;
+    for (const auto& [name, test]: sTests) {
+        if (!names.empty() && std::find(names.begin(), names.end(), name) == names.end())
+            continue;
+        try {
+            test();
+            std::cerr << "OK      " << name << '\n';
+        }
+        catch (TestSkipped& err) {
+            std::cerr << "SKIPPED " << name << ": " << err.what() << '\n';
+        }
+        catch (std::exception& err) {
+            std::cerr << "FAILED  " << name << ": " << err.what() << '\n';
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End: